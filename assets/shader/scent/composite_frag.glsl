@@ -0,0 +1,59 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+// accumulation targets are 1 / divisor of the screen, above 1 they are
+// upsampled with the depths of both resolutions
+uniform int divisor;
+uniform sampler2D lowDepth;
+uniform sampler2D sceneDepth;
+uniform vec2 depthRange;
+
+float linearDepth(float depth)
+{
+    float z = depth * 2.0 - 1.0;
+    return 2.0 * depthRange.x * depthRange.y / (depthRange.y + depthRange.x - z * (depthRange.y - depthRange.x));
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accum;
+    float reveal;
+    if (divisor == 1)
+    {
+        accum = texelFetch(accumulation, texel, 0);
+        reveal = texelFetch(revealage, texel, 0).r;
+    }
+    else
+    {
+        // bilinear over the four nearest low resolution texels, each weighted
+        // down by how far its depth is from the depth of this pixel
+        vec2 low = gl_FragCoord.xy / float(divisor) - 0.5;
+        ivec2 base = ivec2(floor(low));
+        vec2 f = low - vec2(base);
+        ivec2 last = textureSize(accumulation, 0) - 1;
+        float depth = linearDepth(texelFetch(sceneDepth, texel, 0).r);
+        accum = vec4(0.0);
+        reveal = 0.0;
+        float total = 0.0;
+        for (int i = 0; i < 4; ++i)
+        {
+            ivec2 offset = ivec2(i & 1, i >> 1);
+            ivec2 neighbour = clamp(base + offset, ivec2(0), last);
+            vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+            float difference = abs(linearDepth(texelFetch(lowDepth, neighbour, 0).r) - depth) / depth;
+            float weight = bilinear.x * bilinear.y / (difference + 1e-3);
+            accum += weight * texelFetch(accumulation, neighbour, 0);
+            reveal += weight * texelFetch(revealage, neighbour, 0).r;
+            total += weight;
+        }
+        accum /= total;
+        reveal /= total;
+    }
+    float coverage = 1.0 - exp(-reveal);
+    if (coverage < 1e-3)
+        discard;
+    FragColor = vec4(accum.rgb / max(accum.a, 1e-5), coverage);
+}
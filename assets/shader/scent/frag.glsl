@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 Corner;
+in vec4 Color;
+
+void main()
+{
+    // fade out from the center to the sprite radius
+    float alpha = 1.0 - smoothstep(0.0, 1.0, length(Corner));
+    FragColor = vec4(Color.rgb, Color.a * alpha);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+// weighted blended OIT accumulation, both targets blend with GL_ONE, GL_ONE
+layout (location = 0) out vec4 Accumulation;
+layout (location = 1) out float Revealage;
+
+in vec2 Corner;
+in vec4 Color;
+
+void main()
+{
+    float alpha = min(Color.a * (1.0 - smoothstep(0.0, 1.0, length(Corner))), 0.99);
+    // nearer fragments weigh more (McGuire and Bavoil, eq. 10)
+    float z = gl_FragCoord.z;
+    float weight = clamp(alpha * 3e3 * pow(1.0 - z, 3.0), 1e-2, 3e3);
+    Accumulation = vec4(Color.rgb * alpha, alpha) * weight;
+    // summed, exp(-sum) is the product of (1 - alpha)
+    Revealage = -log(1.0 - alpha);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+// per instance: a TrackLog::Sample, position and time, species
+layout (location = 1) in vec4 aPositionTime;
+layout (location = 2) in uint aSpecies;
+
+out vec2 Corner;
+out vec4 Color;
+
+const int MAX_SPECIES = 8;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float now;
+uniform float maxAge;
+uniform float size;
+uniform vec4 speciesColor[MAX_SPECIES];
+
+void main()
+{
+    // flat on the ground, lifted a little against z-fighting
+    vec3 position = aPositionTime.xyz + vec3(aCorner.x * size, 0.02, aCorner.y * size);
+    gl_Position = projection * view * vec4(position, 1.0);
+    Corner = aCorner;
+    // fresh markers are strongest
+    float fresh = clamp(1.0 - (now - aPositionTime.w) / maxAge, 0.0, 1.0);
+    vec4 color = speciesColor[min(int(aSpecies), MAX_SPECIES - 1)];
+    Color = vec4(color.rgb, color.a * fresh);
+}
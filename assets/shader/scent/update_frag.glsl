@@ -0,0 +1,6 @@
+#version 330 core
+// rasterization is discarded while simulating, the program just needs a fragment stage
+
+void main()
+{
+}
@@ -0,0 +1,146 @@
+#version 330 core
+// Only uses what GLSL ES 3.00 has as well, GLShader::platformSource retargets it.
+layout (location = 0) in vec4 aPositionAge;
+layout (location = 1) in vec4 aVelocity;
+
+// captured by transform feedback, in the order of ScentGPU::Particle
+out vec4 PositionAge;
+out vec4 Velocity;
+out vec4 Sprite;
+out vec4 Color;
+
+const int MAX_SOURCES = 16;
+
+uniform int sourceCount;
+// one past the last slot of each source
+uniform int sourceEnd[MAX_SOURCES];
+// first marker and number of markers of the track
+uniform vec4 sourceOrigin[MAX_SOURCES];
+uniform vec3 sourceDirection[MAX_SOURCES];
+
+uniform float time;
+uniform float dt;
+uniform float lifetime;
+uniform float decay;
+uniform float size;
+// rgb and intensity of a fresh particle
+uniform vec4 color;
+
+// false in still air, the field uniforms are then not set
+uniform bool windEnabled;
+// WindField::setUniforms
+const int WIND_PERIOD = 32;
+uniform vec3 windMean;
+uniform vec3 windOffset;
+uniform float windScale;
+uniform float windStrength;
+uniform float windBoundary;
+uniform bool windTerrain;
+uniform sampler2D windHeightMap;
+// (cols, rows) of the heightmap
+uniform vec2 windHeightMapSize;
+// height = windHeightRange.x * texel + windHeightRange.y
+uniform vec2 windHeightRange;
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// uniform in [0, 1)
+float random(uint x)
+{
+    return float(hash(x) >> 8) * (1.0 / 16777216.0);
+}
+
+// The wind of WindField, written the same way as source/scent/WindField.cpp
+
+// gradient of one potential component of the noise at cell + f, 0 <= f < 1
+vec3 noiseGradient(ivec3 cell, vec3 f, uint component)
+{
+    vec3 u = f * f * f * (f * (f * 6.0 - 15.0) + 10.0);
+    vec3 du = 30.0 * f * f * (f - 1.0) * (f - 1.0);
+    vec3 sum = vec3(0.0);
+    for (int corner = 0; corner < 8; ++corner) {
+        ivec3 abc = ivec3(corner & 1, (corner >> 1) & 1, corner >> 2);
+        uvec3 wrapped = uvec3(cell + abc) & uint(WIND_PERIOD - 1);
+        uint h = hash(wrapped.x + uint(WIND_PERIOD) * (wrapped.y + uint(WIND_PERIOD) * (wrapped.z + uint(WIND_PERIOD) * component)));
+        vec3 g = vec3(uvec3(h, h >> 10, h >> 20) & 1023u) * (2.0 / 1023.0) - 1.0;
+        float value = dot(g, f - vec3(abc));
+        vec3 w = mix(1.0 - u, u, vec3(abc));
+        vec3 s = mix(-du, du, vec3(abc));
+        sum += w.x * w.y * w.z * g + s * vec3(w.y * w.z, w.x * w.z, w.x * w.y) * value;
+    }
+    return sum;
+}
+
+float windHeight(int row, int col)
+{
+    return windHeightRange.x * texelFetch(windHeightMap, ivec2(col, row), 0).r + windHeightRange.y;
+}
+
+vec3 wind(vec3 position)
+{
+    vec3 p = (position - windOffset) / windScale;
+    ivec3 cell = ivec3(floor(p));
+    vec3 f = p - vec3(cell);
+    vec3 a = noiseGradient(cell, f, 0u);
+    vec3 b = noiseGradient(cell, f, 1u);
+    vec3 c = noiseGradient(cell, f, 2u);
+    vec3 v = windMean + windStrength * vec3(c.y - b.z, a.z - c.x, b.x - a.y);
+    if (windTerrain) {
+        // bilinear height and slope, as HeightField::slopeAt
+        vec2 size = windHeightMapSize.yx;
+        vec2 rc = position.xz + size * 0.5;
+        vec2 clamped = clamp(rc, vec2(0.0), size - 1.0);
+        ivec2 i = min(ivec2(clamped), ivec2(size) - 2);
+        vec2 t = clamped - vec2(i);
+        float h00 = windHeight(i.x, i.y), h01 = windHeight(i.x, i.y + 1);
+        float h10 = windHeight(i.x + 1, i.y), h11 = windHeight(i.x + 1, i.y + 1);
+        float height = mix(mix(h00, h01, t.y), mix(h10, h11, t.y), t.x);
+        vec2 inside = vec2(greaterThan(rc, vec2(0.0))) * vec2(lessThan(rc, size - 1.0));
+        vec2 slope = inside * vec2(mix(h10 - h00, h11 - h01, t.y), mix(h01 - h00, h11 - h10, t.x));
+        float above = clamp((position.y - height) / windBoundary, 0.0, 1.0);
+        v.y += (1.0 - above) * (1.0 - above) * (dot(v.xz, slope) - v.y);
+    }
+    return v;
+}
+
+void main()
+{
+    int id = gl_VertexID;
+    int source = 0;
+    while (source < sourceCount - 1 && id >= sourceEnd[source])
+        source++;
+
+    vec3 position = aPositionAge.xyz;
+    vec3 velocity = aVelocity.xyz;
+    float age = aPositionAge.w + dt;
+    bool born = aPositionAge.w < 0.0 && age >= 0.0;
+    if (born || age >= lifetime) {
+        // respawn above a random marker of the track
+        if (!born)
+            age -= lifetime;
+        uint seed = hash(uint(id) ^ floatBitsToUint(time));
+        vec4 origin = sourceOrigin[source];
+        float marker = floor(random(seed) * origin.w);
+        position = origin.xyz + sourceDirection[source] * marker + vec3(0.0, 0.6, 0.0);
+        velocity = vec3(0.0);
+    } else if (age > 0.0) {
+        vec3 drift = velocity;
+        if (windEnabled)
+            drift += wind(position);
+        position += drift * dt;
+    }
+
+    PositionAge = vec4(position, age);
+    Velocity = vec4(velocity, 0.0);
+    // unborn particles get an empty sprite
+    Sprite = vec4(position + vec3(0.0, 0.5 * sin(time * 2.0 + float(id)), 0.0), age >= 0.0 ? size : 0.0);
+    Color = vec4(color.rgb, color.a * exp(-decay * max(age, 0.0)));
+}
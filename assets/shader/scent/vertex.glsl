@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+// per instance: world position and sprite radius, color
+layout (location = 1) in vec4 aPositionSize;
+layout (location = 2) in vec4 aColor;
+
+out vec2 Corner;
+out vec4 Color;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    // expand the quad in view space, so it always faces the camera
+    vec4 center = view * vec4(aPositionSize.xyz, 1.0);
+    gl_Position = projection * (center + vec4(aCorner * aPositionSize.w, 0.0, 0.0));
+    Corner = aCorner;
+    Color = aColor;
+}
@@ -4,7 +4,6 @@ out vec4 FragColor;
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
-in vec4 FragPosLightSpace;
 
 struct PointLight {
     vec3 pos;
@@ -21,44 +20,67 @@ struct Material {
 };
 
 uniform Material material;
-uniform sampler2D shadowMap;
+
+#define MAX_CASCADES 4
+// hardware compared: each lookup returns 4 bilinearly filtered comparisons
+uniform sampler2DArrayShadow shadowMap;
+// PCF lookups per fragment: 1, 4 or 9
+uniform int shadowTaps;
+uniform int cascadeCount;
+uniform mat4 lightSpaceMatrices[MAX_CASCADES];
+// view distance where each cascade ends
+uniform float cascadeSplits[MAX_CASCADES];
+// world size of one shadow texel, 1 / light space depth range
+uniform float cascadeTexel[MAX_CASCADES];
+uniform float cascadeDepthScale[MAX_CASCADES];
 
 uniform vec3 view_pos;
+uniform mat4 view;
 
-float ShadowCalculation(vec4 fragPosLightSpace)
+float ShadowCalculation(vec3 fragPos, vec3 normal)
 {
-    // perform perspective divide
-    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    // transform to [0,1] range
-    projCoords = projCoords * 0.5 + 0.5;
-    // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float closestDepth = texture(shadowMap, projCoords.xy).r;
-    // get depth of current fragment from light's perspective
+    // the first cascade reaching the fragment's view depth
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while (cascade < cascadeCount && viewDepth > cascadeSplits[cascade])
+        ++cascade;
+    if (cascade == cascadeCount)
+        return 0.0;
+
+    // move the lookup about a texel off the surface, against acne on slopes
+    float texel = cascadeTexel[cascade];
+    vec4 fragPosLightSpace = lightSpaceMatrices[cascade] * vec4(fragPos + normal * (1.5 * texel), 1.0);
+    // perform perspective divide and transform to [0,1] range
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w * 0.5 + 0.5;
+    // keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
+    if (projCoords.z > 1.0)
+        return 0.0;
     float currentDepth = projCoords.z;
-    // calculate bias (based on depth map resolution and slope)
-    vec3 normal = normalize(Normal);
-    vec3 lightDir = normalize(light.pos - FragPos);
-    float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-    // check whether current frag pos is in shadow
-    // float shadow = currentDepth > closestDepth  ? 1.0 : 0.0;
-    // PCF
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-    for(int x = -1; x <= 1; ++x)
+    // calculate bias (based on the cascade's texel size and slope)
+    vec3 lightDir = normalize(light.pos - fragPos);
+    float bias = texel * cascadeDepthScale[cascade] * max(2.0 * (1.0 - dot(normal, lightDir)), 0.5);
+    // PCF, every lookup already filters a 2x2 footprint: 4 lookups half a
+    // texel apart cover a 3x3 tent, 9 lookups a texel apart a 4x4 one
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0).xy;
+    float ref = currentDepth - bias;
+    if (shadowTaps == 1)
+        return 1.0 - texture(shadowMap, vec4(projCoords.xy, cascade, ref));
+    float lit = 0.0;
+    if (shadowTaps == 4)
     {
-        for(int y = -1; y <= 1; ++y)
+        for(int x = 0; x < 2; ++x)
         {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
-            shadow += currentDepth - bias > pcfDepth  ? 1.0 : 0.0;
+            for(int y = 0; y < 2; ++y)
+                lit += texture(shadowMap, vec4(projCoords.xy + (vec2(x, y) - 0.5) * texelSize, cascade, ref));
         }
+        return 1.0 - lit / 4.0;
     }
-    shadow /= 9.0;
-
-    // keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
-    if(projCoords.z > 1.0)
-        shadow = 0.0;
-
-    return shadow;
+    for(int x = -1; x <= 1; ++x)
+    {
+        for(int y = -1; y <= 1; ++y)
+            lit += texture(shadowMap, vec4(projCoords.xy + vec2(x, y) * texelSize, cascade, ref));
+    }
+    return 1.0 - lit / 9.0;
 }
 
 void main()
@@ -85,7 +107,7 @@ void main()
     vec3 specular = spec * material.Ks * light.Is;
 
     // calculate shadow
-    float shadow = ShadowCalculation(FragPosLightSpace);
+    float shadow = ShadowCalculation(FragPos, normal);
     vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color.rgb;
 
 
@@ -0,0 +1,81 @@
+#version 330 core
+layout (location = 0) in vec2 aGrid;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+uniform sampler2D heightMap;
+// paged terrains sample the tiles TerrainPager keeps resident instead
+uniform bool paged;
+uniform sampler2DArray heightPages;
+// layer of every tile, -1 when it is not resident
+uniform isampler2D pageTable;
+// cells per tile, a tile has pageSize + 1 samples per side
+uniform float pageSize;
+// (cols, rows) of the heightmap
+uniform vec2 heightMapSize;
+// height = heightRange.x * texel + heightRange.y
+uniform vec2 heightRange;
+// camera position the LOD was selected for
+uniform vec3 lodOrigin;
+uniform float gridDim;
+// node origin (row, col) and size in heightmap texels
+uniform vec3 node;
+// distance where morphing to the coarser LOD starts and ends
+uniform vec2 morphRange;
+
+float samplePage(vec2 texel)
+{
+    ivec2 tile = min(ivec2(texel / pageSize), textureSize(pageTable, 0).yx - 1);
+    int layer = texelFetch(pageTable, tile.yx, 0).r;
+    // nodes past the resident radius are not drawn, this only guards stragglers
+    if (layer < 0)
+        return 0.0;
+    vec2 local = texel - vec2(tile) * pageSize;
+    return textureLod(heightPages, vec3((local.yx + 0.5) / (pageSize + 1.0), float(layer)), 0.0).r;
+}
+
+float sampleHeight(vec2 texel)
+{
+    if (paged)
+        return heightRange.x * samplePage(texel) + heightRange.y;
+    vec2 uv = (texel.yx + 0.5) / heightMapSize;
+    return heightRange.x * textureLod(heightMap, uv, 0.0).r + heightRange.y;
+}
+
+vec2 gridToTexel(vec2 grid)
+{
+    return clamp(node.xy + grid * (node.z / gridDim), vec2(0.0), heightMapSize.yx - 1.0);
+}
+
+vec3 texelToWorld(vec2 texel)
+{
+    return vec3(texel.x - heightMapSize.y * 0.5, sampleHeight(texel), texel.y - heightMapSize.x * 0.5);
+}
+
+// central differences over one patch quad, so coarse LODs get smooth normals
+vec3 sampleNormal(vec2 texel)
+{
+    float d = node.z / gridDim;
+    float dx = sampleHeight(texel - vec2(d, 0.0)) - sampleHeight(texel + vec2(d, 0.0));
+    float dz = sampleHeight(texel - vec2(0.0, d)) - sampleHeight(texel + vec2(0.0, d));
+    return normalize(vec3(dx, 2.0 * d, dz));
+}
+
+void main()
+{
+    vec3 pos = texelToWorld(gridToTexel(aGrid));
+    // slide odd vertices onto their even neighbours, which is the next coarser grid
+    float morph = clamp((distance(pos, lodOrigin) - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    vec2 texel = gridToTexel(aGrid - fract(aGrid * 0.5) * 2.0 * morph);
+    pos = texelToWorld(texel);
+
+    FragPos = pos;
+    Normal = sampleNormal(texel);
+    TexCoords = pos.xz / 8.0;
+    gl_Position = projection * view * vec4(pos, 1.0);
+}
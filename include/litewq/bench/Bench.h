@@ -0,0 +1,59 @@
+#ifndef LITEWQ_BENCH_H
+#define LITEWQ_BENCH_H
+
+#include <cstddef>
+
+namespace litewq {
+
+class HeightField;
+class Terrain;
+class TriMesh;
+
+/// \brief Headless CPU benchmarks, run by `litewq --bench` before any window
+/// or GL context exists. Results are written to the log.
+void RunBenchmarks();
+/// \brief GPU benchmarks, run by `litewq --bench` once the GL context is
+/// current, into offscreen targets.
+void RunGLBenchmarks();
+
+/// \brief Throughput of HeightField::intersect for picking, line of sight
+/// and vertical drop rays, one thread and batched.
+void BenchTerrainRays(const HeightField &height_field, size_t rays);
+
+/// \brief Build time of the BVH of mesh, and queries per second of exact
+/// any hit and collect all collision against the bound overlaps of the same
+/// tree as one heap allocated node per node, with the share of bound hits
+/// that were false positives.
+void BenchBVHCollision(const char *name, TriMesh *mesh, size_t queries);
+/// \brief Closest hit and any hit ray throughput of the BVH of mesh for
+/// picking, snapping down onto it and line of sight rays, one thread and
+/// batched, checked against testing every triangle.
+void BenchBVHRays(const char *name, TriMesh *mesh, size_t rays);
+
+/// \brief WindField::velocity in particles per millisecond, one point at a
+/// time against batched, in open air and following the terrain.
+void BenchWind(const Terrain &terrain, size_t particles);
+
+/// \brief GPU time of a ScentGPU update in still air, in a WindField in
+/// open air and in one following terrain, in particles per millisecond.
+/// terrain must have its GL resources.
+void BenchScentWindGPU(const Terrain &terrain, size_t particles);
+
+/// \brief TrackLog::nearest and TrackLog::visible in microseconds over
+/// ten minutes of animals wandering, against a scan of every sample.
+void BenchTrackQueries(size_t animals);
+
+/// \brief ScentBatch::sort against std::sort on view depth.
+void BenchScentSort(size_t particles);
+
+/// \brief GPU time of drawing particles sorted and alpha blended against
+/// weighted blended OIT, plus the CPU time of the sort.
+void BenchScentTransparency(size_t particles);
+
+/// \brief GPU time of drawing particles with weighted blended OIT at 1080p
+/// into full, half and quarter resolution targets, upsample included.
+void BenchScentResolution(size_t particles);
+
+} // end namespace litewq
+
+#endif // LITEWQ_BENCH_H
@@ -3,6 +3,7 @@
 #define LITEWQ_SCENE_H
 
 #include "litewq/math/BoundingBox.h"
+#include "litewq/math/Frustum.h"
 #include <vector>
 
 namespace litewq {
@@ -13,7 +14,15 @@ class Scene {
 public:
     /* collision detection */
     bool collision(const Bounds3 &hitbox);
+    /* closest hit of ray with the objects that have a BVH, for picking */
+    bool intersect(const Ray &ray, RayHit *hit) const;
     void render() const;
+    enum class Motion { ANY, STATIC, DYNAMIC };
+    /* only the objects whose world bound intersects frustum */
+    void render(const Frustum &frustum, Motion motion = Motion::ANY) const;
+    bool visible(const Frustum &frustum, Motion motion = Motion::ANY) const;
+    /* depth only passes, draws the position-only streams */
+    void renderDepth(const Frustum &frustum, Motion motion = Motion::ANY) const;
     void addObject(TriMesh *mesh) {
         objects.push_back(mesh);
     }
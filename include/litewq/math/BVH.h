@@ -1,37 +1,86 @@
-
 #ifndef LITEWQ_BVH_H
 #define LITEWQ_BVH_H
 
 #include "litewq/math/BoundingBox.h"
+#include "litewq/math/Ray.h"
+
+#include <cstdint>
 #include <vector>
 
 
 namespace litewq {
 
 class Shape;
-class Ray;
 
-struct BVHNode {
-    Bounds3 bound;
-    BVHNode *left = nullptr;
-    BVHNode *right = nullptr;
+/// \brief BVH node, 32 bytes so two share a cache line.
+///
+/// Nodes are stored depth first in one array: the first child of an interior
+/// node is the next node, the second one is at secondChildOffset. A leaf
+/// covers nShapes shapes from shapesOffset.
+struct LinearBVHNode {
+    glm::vec3 pMin;
+    union {
+        uint32_t shapesOffset;      // leaf
+        uint32_t secondChildOffset; // interior
+    };
+    glm::vec3 pMax;
+    /* 0 for interior nodes */
+    uint16_t nShapes;
+    /* split axis of interior nodes */
+    uint8_t axis;
+    uint8_t pad;
+
+    Bounds3 bound() const { return Bounds3(pMin, pMax); }
+    bool overlaps(const Bounds3 &bbox) const {
+        return pMax.x >= bbox.pMin.x && pMin.x <= bbox.pMax.x &&
+               pMax.y >= bbox.pMin.y && pMin.y <= bbox.pMax.y &&
+               pMax.z >= bbox.pMin.z && pMin.z <= bbox.pMax.z;
+    }
+    bool intersectP(const Ray &ray) const { return IntersectSlabs(pMin, pMax, ray); }
 };
 
 class BVHUtils {
 public:
+    /* deepest tree the traversal stack holds */
+    static constexpr int MAX_DEPTH = 64;
+
+    /// \brief Takes over shapes, which are reordered so every leaf covers a
+    /// contiguous range, and deletes them with the tree.
+    ///
+    /// Binned SAH build: the shape bounds are computed once, every node is
+    /// split at the best of 12 planes along its widest centroid axis
+    /// and partitioned in place, large subtrees are built as OpenMP tasks.
+    /// Leaves hold at most maxShapeInNode shapes, fewer when splitting is
+    /// cheaper.
     BVHUtils(std::vector<Shape *> &shapes, unsigned int maxShapeInNode = 1);
-    BVHNode *root = nullptr;
+    ~BVHUtils();
+    BVHUtils(const BVHUtils &) = delete;
+    BVHUtils &operator=(const BVHUtils &) = delete;
 
-    bool intersect(const Bounds3 &bbox) const {
-        return root != nullptr && intersect(root, bbox);
-    }
-    bool intersect(BVHNode *node, const Bounds3 &bbox) const;
+    /// \brief Whether any shape overlaps bbox, exactly (Shape::OverlapsBox),
+    /// stopping at the first one.
+    bool intersect(const Bounds3 &bbox) const;
+    /// \brief Append every shape overlapping bbox to hits, returns how many.
+    size_t intersect(const Bounds3 &bbox, std::vector<Shape *> *hits) const;
+
+    /// \brief Closest hit along ray up to ray.tMax, nearer children first.
+    bool intersect(const Ray &ray, RayHit *hit) const;
+    /// \brief Whether ray hits anything, stopping at the first hit, for
+    /// line of sight.
+    bool intersectP(const Ray &ray) const;
+    /// \brief Batched queries split across threads. Misses get t = infinity,
+    /// both return the number of rays that hit.
+    size_t intersect(const Ray *rays, RayHit *hits, size_t count) const;
+    size_t intersectP(const Ray *rays, uint8_t *hits, size_t count) const;
     Bounds3 WorldBound() const {
-        return root->bound;
+        return nodes.empty() ? Bounds3() : nodes[0].bound();
     }
 
     unsigned int maxShapeInNode = 1;
     std::vector<Shape *> shapes;
+    /* world bound of every shape, in shapes order */
+    std::vector<Bounds3> shapeBounds;
+    std::vector<LinearBVHNode> nodes;
 };
 
 } // end namespace litewq
@@ -3,6 +3,7 @@
 #define LITEWQ_BOUNDINGBOX_H
 
 #include "litewq/math/BasicFunction.h"
+#include "litewq/math/Ray.h"
 
 #include <algorithm>
 #include <glm/glm.hpp>
@@ -82,13 +83,39 @@ public:
 //        *center = (pMin + pMax) / 2;
 //        *radius = Inside(*center, *this) ? Distance(*center, pMax) : 0;
 //    }
-//
-//    bool IntersectP(const Ray &ray, Float *hitt0 = nullptr, Float *hitt1 = nullptr) const;
-//    inline bool IntersectP(const Ray &ray, const Vector3f &invDir,
-//                           const int dirIsNeg[3]) const;
+
+    /// \brief Whether ray passes through the box for some t in (0, ray.tMax].
+    inline bool IntersectP(const Ray &ray) const;
     glm::vec3 pMin, pMax;
 };
 
+/// \brief Slab test of the box [pMin, pMax] with the precomputed inverse
+/// direction of ray. The far distances are widened by 2 gamma(3) so rounding
+/// never drops a ray grazing the box (pbrt 3.9.2).
+inline bool IntersectSlabs(const glm::vec3 &pMin, const glm::vec3 &pMax, const Ray &ray) {
+    constexpr float epsilon = std::numeric_limits<float>::epsilon() * 0.5f;
+    constexpr float widen = 1.0f + 2.0f * (3.0f * epsilon) / (1.0f - 3.0f * epsilon);
+    float tMin = ((ray.dirIsNeg[0] ? pMax : pMin).x - ray.o.x) * ray.invDir.x;
+    float tMax = ((ray.dirIsNeg[0] ? pMin : pMax).x - ray.o.x) * ray.invDir.x * widen;
+    float tyMin = ((ray.dirIsNeg[1] ? pMax : pMin).y - ray.o.y) * ray.invDir.y;
+    float tyMax = ((ray.dirIsNeg[1] ? pMin : pMax).y - ray.o.y) * ray.invDir.y * widen;
+    if (tMin > tyMax || tyMin > tMax)
+        return false;
+    if (tyMin > tMin) tMin = tyMin;
+    if (tyMax < tMax) tMax = tyMax;
+    float tzMin = ((ray.dirIsNeg[2] ? pMax : pMin).z - ray.o.z) * ray.invDir.z;
+    float tzMax = ((ray.dirIsNeg[2] ? pMin : pMax).z - ray.o.z) * ray.invDir.z * widen;
+    if (tMin > tzMax || tzMin > tMax)
+        return false;
+    if (tzMin > tMin) tMin = tzMin;
+    if (tzMax < tMax) tMax = tzMax;
+    return tMin < ray.tMax && tMax > 0.0f;
+}
+
+inline bool Bounds3::IntersectP(const Ray &ray) const {
+    return IntersectSlabs(pMin, pMax, ray);
+}
+
 inline Bounds3
 Union(const Bounds3 &b, const glm::vec3 &p) {
     return Bounds3(glm::vec3(std::min(b.pMin.x, p.x),
@@ -134,6 +161,12 @@ bool Inside(const glm::vec3 &p, const Bounds3 &b) {
             p.z >= b.pMin.z && p.z <= b.pMax.z);
 }
 
+inline
+bool IntersectSphere(const Bounds3 &b, const glm::vec3 &center, float radius) {
+    glm::vec3 d = center - glm::clamp(center, b.pMin, b.pMax);
+    return glm::dot(d, d) <= radius * radius;
+}
+
 inline Bounds3
 Expand(const Bounds3 &b, float delta) {
     return Bounds3(b.pMin - glm::vec3 (delta, delta, delta),
@@ -0,0 +1,63 @@
+#ifndef LITEWQ_FRUSTUM_H
+#define LITEWQ_FRUSTUM_H
+
+#include "litewq/math/BoundingBox.h"
+
+#include <glm/glm.hpp>
+
+namespace litewq {
+
+/// \brief View frustum as six inward facing planes (ax + by + cz + d >= 0),
+/// extracted from a combined projection * view matrix.
+class Frustum {
+public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4 &view_projection) {
+        glm::mat4 M = glm::transpose(view_projection);
+        planes[0] = M[3] + M[0]; // left
+        planes[1] = M[3] - M[0]; // right
+        planes[2] = M[3] + M[1]; // bottom
+        planes[3] = M[3] - M[1]; // top
+        planes[4] = M[3] + M[2]; // near
+        planes[5] = M[3] - M[2]; // far
+        for (auto &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+
+        /* world corners of the clip cube */
+        glm::mat4 inverse = glm::inverse(view_projection);
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec4 p = inverse * glm::vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f,
+                                              corner & 4 ? 1.0f : -1.0f, 1.0f);
+            bounds = Union(bounds, glm::vec3(p) / p.w);
+        }
+    }
+
+    /// \brief Conservative AABB test, only rejects boxes that lie
+    /// entirely on the outer side of one plane.
+    bool intersect(const Bounds3 &bbox) const {
+        for (const auto &plane : planes) {
+            /* the corner furthest along the plane normal */
+            glm::vec3 p(plane.x >= 0 ? bbox.pMax.x : bbox.pMin.x,
+                        plane.y >= 0 ? bbox.pMax.y : bbox.pMin.y,
+                        plane.z >= 0 ? bbox.pMax.z : bbox.pMin.z);
+            if (glm::dot(glm::vec3(plane), p) + plane.w < 0)
+                return false;
+        }
+        return true;
+    }
+
+    bool contains(const glm::vec3 &point) const {
+        for (const auto &plane : planes)
+            if (glm::dot(glm::vec3(plane), point) + plane.w < 0)
+                return false;
+        return true;
+    }
+
+    glm::vec4 planes[6];
+    /* world AABB of the frustum corners */
+    Bounds3 bounds;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_FRUSTUM_H
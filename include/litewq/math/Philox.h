@@ -0,0 +1,42 @@
+#ifndef LITEWQ_PHILOX_H
+#define LITEWQ_PHILOX_H
+
+#include <array>
+#include <cstdint>
+
+namespace litewq {
+
+/// \brief Philox4x32-10 counter based random numbers (Salmon et al. 2011).
+///
+/// Every (counter, key) pair maps to four independent 32-bit values with no
+/// state in between, so numbers can be drawn in any order, on any thread or
+/// SIMD lane, and still be bit for bit reproducible: key them by what they
+/// belong to (e.g. a source) and count by when and what they are for (e.g.
+/// simulation tick and marker).
+struct Philox {
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+
+    static Counter generate(Counter counter, Key key) {
+        for (int round = 0; round < 10; ++round) {
+            if (round > 0) {
+                key[0] += 0x9E3779B9u;
+                key[1] += 0xBB67AE85u;
+            }
+            uint64_t product0 = uint64_t(0xD2511F53u) * counter[0];
+            uint64_t product1 = uint64_t(0xCD9E8D57u) * counter[2];
+            counter = {uint32_t(product1 >> 32) ^ counter[1] ^ key[0], uint32_t(product1),
+                       uint32_t(product0 >> 32) ^ counter[3] ^ key[1], uint32_t(product0)};
+        }
+        return counter;
+    }
+
+    /// \brief Uniform float in [0, 1) from the high 24 of 32 random bits.
+    static float uniform(uint32_t bits) {
+        return float(bits >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_PHILOX_H
@@ -0,0 +1,62 @@
+#ifndef LITEWQ_RAY_H
+#define LITEWQ_RAY_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <limits>
+
+namespace litewq {
+
+class Shape;
+
+/// \brief Ray o + t * d for t in (0, tMax], with what the slab test and the
+/// watertight triangle test (Woop et al. 2013) derive from the direction
+/// computed once.
+///
+/// d need not be normalized, t is in units of its length. Queries leave the
+/// ray as it is, closest hit queries shrink a copy of tMax as they find hits.
+class Ray {
+public:
+    Ray() = default;
+    Ray(const glm::vec3 &o, const glm::vec3 &d, float tMax = std::numeric_limits<float>::infinity())
+        : o(o), d(d), tMax(tMax) {
+        invDir = 1.0f / d;
+        dirIsNeg[0] = invDir.x < 0.0f;
+        dirIsNeg[1] = invDir.y < 0.0f;
+        dirIsNeg[2] = invDir.z < 0.0f;
+        /* the axis along which d is largest becomes z */
+        glm::vec3 a = glm::abs(d);
+        kz = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        shear = glm::vec3(-d[kx] / d[kz], -d[ky] / d[kz], 1.0f / d[kz]);
+    }
+
+    glm::vec3 operator()(float t) const { return o + d * t; }
+
+    glm::vec3 o, d;
+    float tMax = std::numeric_limits<float>::infinity();
+    glm::vec3 invDir;
+    int dirIsNeg[3];
+    /* permutation and shear taking d to +z */
+    int kx, ky, kz;
+    glm::vec3 shear;
+};
+
+/// \brief Where a ray hit a shape.
+struct RayHit {
+    float t = std::numeric_limits<float>::infinity();
+    glm::vec3 position;
+    /* weights of the triangle vertices v[0], v[1], v[2] at the hit */
+    glm::vec3 barycentric;
+    Shape *shape = nullptr;
+    /* index of the triangle in its mesh (global_indices_[3 * triangle]),
+       and of the submesh holding it */
+    unsigned int triangle = 0;
+    unsigned int submesh = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_RAY_H
@@ -2,6 +2,8 @@
 #ifndef LITEWQ_SHAPE_H
 #define LITEWQ_SHAPE_H
 
+#include "litewq/math/Ray.h"
+
 #include <glm/glm.hpp>
 
 namespace litewq {
@@ -14,8 +16,15 @@ public:
     Shape() = delete;
     explicit Shape(glm::mat4 *ObjectToWorld) :
             ObjectToWorld(ObjectToWorld) {}
+    virtual ~Shape() = default;
     virtual Bounds3 ObjectBound() = 0;
     virtual Bounds3 WorldBound();
+    /// \brief Whether the shape in world space overlaps bbox, by default
+    /// whether its world bound does.
+    virtual bool OverlapsBox(const Bounds3 &bbox);
+    /// \brief Hit of ray with the shape in world space for t in
+    /// (0, ray.tMax], hit is only written when there is one.
+    virtual bool Intersect(const Ray &ray, RayHit *hit) = 0;
 
     glm::mat4 *ObjectToWorld;
 };
@@ -26,10 +35,20 @@ public:
     Triangle(glm::mat4 *ObjectToWorld, TriMesh *Mesh, unsigned int *V) :
             Shape(ObjectToWorld), mesh(Mesh), v(V) {}
     virtual Bounds3 ObjectBound() override;
+    /// \brief Exact triangle against box test.
+    virtual bool OverlapsBox(const Bounds3 &bbox) override;
+    /// \brief Watertight ray triangle test (Woop et al. 2013): rays through
+    /// an edge or vertex shared by two triangles hit at least one of them.
+    virtual bool Intersect(const Ray &ray, RayHit *hit) override;
+    glm::vec3 WorldVertex(int i) const;
     TriMesh *mesh;
     const unsigned int *v;
 };
 
+/// \brief Separating axis test of the triangle (v0, v1, v2) against bbox
+/// (Akenine-Moller 2001), touching counts as overlapping.
+bool TriangleOverlapsBox(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, const Bounds3 &bbox);
+
 } // end namespace litewq
 
 
@@ -0,0 +1,64 @@
+#ifndef LITEWQ_SPATIALHASH_H
+#define LITEWQ_SPATIALHASH_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace litewq {
+
+/// \brief Uniform grid over the ground plane (world x, z) hashed into a fixed
+/// size table, for "what is near here" queries over many objects.
+///
+/// Objects are inserted with their xz bounds and registered in every cell
+/// they overlap, then build() packs the table into two flat arrays (a
+/// counting sort by bucket), so queries touch contiguous memory. Distinct
+/// cells can share a bucket: queries return candidates, an id may come up
+/// more than once, and callers test the actual bounds.
+class SpatialHash {
+public:
+    SpatialHash() = delete;
+    /// \brief buckets is rounded up to a power of two.
+    SpatialHash(float cell_size, size_t buckets);
+
+    void clear();
+    void insert(uint32_t id, const glm::vec2 &min, const glm::vec2 &max);
+    void insert(uint32_t id, const glm::vec2 &point) { insert(id, point, point); }
+    /// \brief Pack the inserted objects, required before querying.
+    void build();
+
+    /// \brief Call visit(id) for the objects in the buckets of the cells
+    /// overlapping [min, max].
+    template <typename Visit>
+    void query(const glm::vec2 &min, const glm::vec2 &max, Visit &&visit) const {
+        glm::ivec2 lo = cell(min), hi = cell(max);
+        for (int x = lo.x; x <= hi.x; ++x)
+            for (int z = lo.y; z <= hi.y; ++z) {
+                size_t b = bucket(x, z);
+                for (uint32_t e = bucket_start_[b]; e < bucket_start_[b + 1]; ++e)
+                    visit(entries_[e]);
+            }
+    }
+
+    float cellSize() const { return cell_size_; }
+
+private:
+    glm::ivec2 cell(const glm::vec2 &p) const {
+        return glm::ivec2(glm::floor(p / cell_size_));
+    }
+    size_t bucket(int x, int z) const {
+        return (uint32_t(x) * 73856093u ^ uint32_t(z) * 19349663u) & mask_;
+    }
+
+    float cell_size_;
+    size_t mask_;
+    /* (bucket, id) pairs until build() */
+    std::vector<std::pair<uint32_t, uint32_t>> pending_;
+    std::vector<uint32_t> bucket_start_;
+    std::vector<uint32_t> entries_;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_SPATIALHASH_H
@@ -5,6 +5,7 @@ namespace litewq {
 
 class Mesh {
 public:
+    virtual ~Mesh() = default;
     virtual void initGL();
     virtual void render();
 };
@@ -43,10 +43,15 @@ public:
         Material * material = nullptr;
     };
     std::vector<SubMeshArea> offsets_;
+    /// \brief Submesh whose indices hold global_indices_[index], 0 without
+    /// submeshes.
+    unsigned int submeshOf(unsigned int index) const;
 
     GLShader *shader = nullptr;
 
     glm::mat4 model {glm::mat4(1.0f)};
+    /* moves between frames, kept out of cached shadow maps */
+    bool dynamic = false;
     /* Assume all submesh use one shader */
     BVHUtils *bvh = nullptr;
     Bounds3 ObjectBound;
@@ -82,15 +87,21 @@ public:
         offsets_.push_back(submesh_offset);
     }
 
+    ~TriMesh() override { delete bvh; }
+
     virtual void render() override;
     /* portable API for debug */
     void renderSubMesh(unsigned int index);
+    /* depth only passes: positions only, all submeshes in one draw */
+    void renderDepth();
 
     virtual void initGL() override;
     void finishGL();
 private:
     bool need_rendering_ = false;
     unsigned int VAO, VBO, EBO;
+    /* tightly packed, welded positions with their own indices */
+    unsigned int DepthVAO, DepthVBO, DepthEBO;
 
 
 };
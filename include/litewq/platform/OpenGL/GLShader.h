@@ -4,21 +4,29 @@
 
 #include <string>
 #include <cstddef>
+#include <vector>
 
 namespace litewq {
 
 class GLShader {
 public:
-    GLShader(const std::string &vertex_src, const std::string &frag_src);
+    /// \brief feedback_varyings are captured interleaved, in this order, by
+    /// transform feedback.
+    GLShader(const std::string &vertex_src, const std::string &frag_src,
+             const std::vector<std::string> &feedback_varyings = {});
     ~GLShader();
 
     static GLShader *GetCurrentShader();
+    /// \brief Shaders are written as "#version 330 core". GLES builds swap
+    /// that line for "#version 300 es" and default precisions.
+    static std::string platformSource(const std::string &source);
 
     void Bind() const;
     void UnBind() const;
 
     void updateUniformInt(const std::string &name, const int);
     void updateUniformFloat(const std::string &name, const float);
+    void updateUniformFloat2(const std::string &name, const glm::vec2 &vec);
     void updateUniformFloat3(const std::string &name, const glm::vec3 &vec);
     void updateUniformFloat3v(const std::string &name, unsigned count, const float *value);
     void updateUniformFloat4(const std::string &name, const glm::vec4 &vec);
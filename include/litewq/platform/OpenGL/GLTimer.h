@@ -0,0 +1,38 @@
+#ifndef LITEWQ_GLTIMER_H
+#define LITEWQ_GLTIMER_H
+
+#include <cstdint>
+
+namespace litewq {
+
+/// \brief GPU time of the commands between begin() and end(), averaged over
+/// the frames since the last reset(). Results are read LATENCY frames later,
+/// when the GPU is done with them, so the CPU never waits on the query.
+class GLTimer {
+public:
+    static constexpr int LATENCY = 3;
+
+    void initGL();
+    void finishGL();
+
+    void begin();
+    void end();
+
+    /// \brief Average milliseconds per begin() / end() pair.
+    double average() const { return samples_ ? total_ms_ / samples_ : 0.0; }
+    int samples() const { return samples_; }
+    void reset() {
+        total_ms_ = 0.0;
+        samples_ = 0;
+    }
+
+private:
+    unsigned int queries_[LATENCY] = {};
+    uint64_t frame_ = 0;
+    double total_ms_ = 0.0;
+    int samples_ = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_GLTIMER_H
@@ -0,0 +1,58 @@
+#ifndef LITEWQ_SCENTBATCH_H
+#define LITEWQ_SCENTBATCH_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace litewq {
+
+class GLShader;
+
+/// \brief Scent sprites drawn with a single instanced call.
+///
+/// Every instance is a camera facing quad around its position, the vertex
+/// shader expands it in view space and the fragment shader fades it out
+/// radially. Instances are collected on the CPU each frame and streamed
+/// into an orphaned buffer, so the GPU never waits on last frame's data.
+class ScentBatch {
+public:
+    struct Instance {
+        glm::vec3 position;
+        /* world radius of the sprite */
+        float size;
+        glm::vec4 color;
+    };
+
+    void initGL();
+    void finishGL();
+
+    void clear() { instances_.clear(); }
+    void add(const glm::vec3 &position, float size, const glm::vec4 &color) {
+        instances_.push_back({position, size, color});
+    }
+    /// \brief Order the instances back to front for alpha blending. The view
+    /// depths are quantized to 16 bits and radix sorted, two 8-bit passes
+    /// with per-thread histograms, so the cost is linear and split over threads.
+    void sort(const glm::mat4 &view);
+    /// \brief Upload the instances and draw them blended, without depth writes,
+    /// with a shader using shader/scent/vertex.glsl.
+    void render(GLShader &shader, const glm::mat4 &view, const glm::mat4 &projection);
+
+    std::vector<Instance> instances_;
+
+private:
+    /* sort() scratch, kept to avoid allocating every frame */
+    std::vector<uint16_t> keys_[2];
+    std::vector<uint32_t> order_[2];
+    std::vector<Instance> sorted_;
+
+    unsigned int VAO = 0, quad_VBO = 0, instance_VBO = 0;
+    /* instances the streamed buffer has room for */
+    size_t capacity_ = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_SCENTBATCH_H
@@ -0,0 +1,97 @@
+#ifndef LITEWQ_SCENTFIELD_H
+#define LITEWQ_SCENTFIELD_H
+
+#include <glm/glm.hpp>
+
+#include <mutex>
+#include <vector>
+
+namespace litewq {
+
+/// \brief Scent concentration on a grid over the terrain, so gameplay can ask
+/// how strong a scent is at a point and which way it gets stronger.
+///
+/// The grid has rows x cols cells of cell_size along world x and z and a few
+/// layers of layer_height along y, starting at origin. Values sit at cell
+/// centers. Every step() advects the concentration along the per cell
+/// horizontal wind (semi-Lagrangian, unconditionally stable), then solves
+/// diffusion and decay implicitly with a few Jacobi iterations, so large
+/// time steps stay stable too. Rows are spread over threads, columns are
+/// vectorized. Concentration leaves nothing through the border.
+///
+/// Everything but the snapshot queries belongs to the thread stepping the
+/// field. publish() copies the concentration for concentrationSnapshot()
+/// and sampleSnapshot(), which any other thread may call meanwhile.
+class ScentField {
+public:
+    ScentField() = delete;
+    ScentField(const glm::vec3 &origin, float cell_size, int rows, int cols, int layers, float layer_height);
+
+    /// \brief Same wind in every cell, only x and z are used.
+    void setWind(const glm::vec3 &wind);
+    /// \brief Add amount to the cells around position, trilinearly weighted.
+    /// Positions outside the grid are ignored.
+    void inject(const glm::vec3 &position, float amount);
+    void step(float dt);
+    void clear();
+
+    bool contains(const glm::vec3 &position) const {
+        return inside((position.x - origin_.x) / cell_size_ - 0.5f, (position.z - origin_.z) / cell_size_ - 0.5f,
+                      (position.y - origin_.y) / layer_height_ - 0.5f);
+    }
+    /// \brief Trilinear concentration at position, 0 outside the grid.
+    /// Stepping thread only.
+    float concentration(const glm::vec3 &position) const;
+    /// \brief Concentration and its world space gradient at count positions,
+    /// gradient may be null. Spread over threads for large batches. Stepping
+    /// thread only.
+    void sample(const glm::vec3 *positions, size_t count, float *concentration, glm::vec3 *gradient) const;
+
+    /// \brief Make the current concentration the snapshot. Stepping thread.
+    void publish();
+    /// \brief As concentration() and sample(), on the last publish(), from
+    /// any thread. All zero before the first one.
+    float concentrationSnapshot(const glm::vec3 &position) const;
+    void sampleSnapshot(const glm::vec3 *positions, size_t count, float *concentration, glm::vec3 *gradient) const;
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int layers() const { return layers_; }
+    size_t index(int layer, int row, int col) const {
+        return (size_t(layer) * rows_ + row) * cols_ + col;
+    }
+
+    /* m^2/s and 1/s */
+    float diffusion_ = 0.5f;
+    float decay_ = 0.05f;
+    int iterations_ = 4;
+
+    /* per cell wind along x and z, layer major like the concentration */
+    std::vector<float> wind_x_, wind_z_;
+
+private:
+    /* cell coordinates within the grid, cells reach half a cell past the centers */
+    bool inside(float u, float v, float w) const {
+        return u >= -0.5f && v >= -0.5f && w >= -0.5f &&
+               u <= rows_ - 0.5f && v <= cols_ - 0.5f && w <= layers_ - 0.5f;
+    }
+    void advect(float dt);
+    void diffuse(float dt);
+    void sample(const std::vector<float> &grid, const glm::vec3 *positions, size_t count, float *concentration,
+                glm::vec3 *gradient) const;
+
+    glm::vec3 origin_;
+    float cell_size_, layer_height_;
+    int rows_, cols_, layers_;
+    std::vector<float> concentration_;
+    /* advected field, right hand side of the implicit solve */
+    std::vector<float> advected_, jacobi_;
+
+    /* published_ is guarded by mutex_, back_ is the next one being copied */
+    mutable std::mutex mutex_;
+    std::vector<float> published_, back_;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_SCENTFIELD_H
@@ -0,0 +1,94 @@
+#ifndef LITEWQ_SCENTGPU_H
+#define LITEWQ_SCENTGPU_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace litewq {
+
+class GLShader;
+class WindField;
+
+/// \brief Scent particles simulated entirely on the GPU, for clouds too large
+/// to update on the CPU (hundreds of thousands of particles).
+///
+/// Particle state is ping-ponged between two buffers: every update() runs the
+/// particles of one buffer through shader/scent/update_vertex.glsl and
+/// captures the result in the other with transform feedback. The shader
+/// advects, ages and bobs the particles and respawns the expired ones on
+/// their source track, writing the sprite attributes of ScentBatch next to
+/// the state, so the output buffer is drawn as is.
+///
+/// Every source owns a fixed range of slots, one particle per slot. Slots
+/// start unborn with staggered ages so emission is spread over a lifetime.
+/// After initGL() the CPU only uploads the per-source tracks and the wind
+/// field as uniforms. Only OpenGL ES 3.0 features are used, GLES builds
+/// (cmake -DGLES=ON) run it on a mobile context.
+class ScentGPU {
+public:
+    static constexpr int MAX_SOURCES = 16;
+
+    /// \brief lifetime is the age in seconds particles respawn at, decay the
+    /// rate their intensity fades with.
+    ScentGPU(GLShader &update_shader, float lifetime, float decay);
+
+    /// \brief Add a track of length markers from origin along direction that
+    /// keeps budget particles alive. Sources are added before initGL().
+    int addSource(const glm::vec3 &origin, const glm::vec3 &direction, int length, size_t budget);
+    /// \brief Field the particles drift with, evaluated in the shader, nullptr
+    /// for still air, where the shader skips the field. Kept by pointer, read
+    /// on every update().
+    void setWind(const WindField *wind) { wind_ = wind; }
+
+    void initGL();
+    void finishGL();
+
+    void update(float dt);
+    /// \brief Draw the latest state with a shader using shader/scent/vertex.glsl.
+    void render(GLShader &shader, const glm::mat4 &view, const glm::mat4 &projection);
+
+    size_t capacity() const { return capacity_; }
+
+    glm::vec3 color_ = glm::vec3(0.95f, 0.54f, 0.21f);
+    /* alpha of a freshly spawned particle */
+    float intensity_ = 1.0f;
+    float size_ = 0.1f;
+    /* the wind field binds the terrain heights here */
+    unsigned int wind_tex_unit_ = 3;
+
+private:
+    /* layout of a particle in the state buffers, see update_vertex.glsl */
+    struct Particle {
+        glm::vec4 position_age;
+        glm::vec4 velocity;
+        glm::vec4 sprite;
+        glm::vec4 color;
+    };
+
+    struct Source {
+        glm::vec3 origin, direction;
+        int length;
+        /* one past the last slot of the source */
+        size_t end;
+    };
+
+    GLShader &update_shader_;
+    float lifetime_, decay_;
+    std::vector<Source> sources_;
+    const WindField *wind_ = nullptr;
+    size_t capacity_ = 0;
+    double time_ = 0.0;
+
+    /* state buffers and their update / render vertex arrays, current_ is
+       the buffer holding the latest state */
+    unsigned int state_VBO_[2] = {0, 0};
+    unsigned int update_VAO_[2] = {0, 0};
+    unsigned int render_VAO_[2] = {0, 0};
+    unsigned int quad_VBO_ = 0;
+    int current_ = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_SCENTGPU_H
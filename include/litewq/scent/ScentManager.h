@@ -0,0 +1,180 @@
+#ifndef LITEWQ_SCENTMANAGER_H
+#define LITEWQ_SCENTMANAGER_H
+
+#include "litewq/math/SpatialHash.h"
+#include "litewq/scent/ScentBatch.h"
+#include "litewq/scent/ScentParticles.h"
+#include "litewq/scent/WindField.h"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace litewq {
+
+class GLShader;
+class ScentField;
+
+/// \brief Every scent source of the world, from animal tracks to carcasses,
+/// dens and scent posts, simulated together and drawn with one instanced batch.
+///
+/// Sources are indexed by a SpatialHash, so the work near the camera does
+/// not grow with the size of the world. With the distance to the camera:
+/// - up to near_distance sources emit and show all their markers;
+/// - further out every level halves the markers (each one emits for the
+///   skipped ones) and emission fades out;
+/// - past cull_distance sources neither emit nor draw.
+/// All sources still inject into the ScentField, it feeds gameplay and must
+/// not depend on the camera.
+///
+/// Particles share one pool. Each source has its own budget of live
+/// particles within it.
+///
+/// The simulation advances in fixed steps of STEP seconds. Its random numbers
+/// come from Philox keyed by seed and source and counted by tick and marker,
+/// so its result only depends on the number of steps and the camera positions
+/// seen, not on the frame rate or the number of threads. start() runs it on a
+/// worker thread in real time. Every batch of steps publishes a snapshot and
+/// render() interpolates between the last two.
+class ScentManager {
+public:
+    static constexpr float STEP = 1.0f / 60.0f;
+
+    enum class SourceKind { TRACK, CARCASS, DEN, POST };
+
+    struct Source {
+        SourceKind kind;
+        /* start of a track, or the point */
+        glm::vec3 position;
+        glm::vec3 direction;
+        /* markers one unit apart along direction, 1 for points */
+        int length;
+        /* concentration injected per marker and second */
+        float strength;
+        /* most live particles */
+        size_t budget;
+    };
+
+    struct LodConfig {
+        float near_distance = 20.0f;
+        float cull_distance = 80.0f;
+        /* markers are halved at most this many times */
+        int max_level = 3;
+    };
+
+    /// \brief budget is the size of the particle pool shared by all sources,
+    /// seed selects the random numbers of the simulation.
+    ScentManager(GLShader &shader, size_t budget, uint32_t seed);
+    ~ScentManager();
+    ScentManager(const ScentManager &) = delete;
+    ScentManager &operator=(const ScentManager &) = delete;
+
+    /// \brief Sources are added before start().
+    int addTrack(const glm::vec3 &origin, const glm::vec3 &direction, int length,
+                 float strength = 1.0f, size_t budget = 200);
+    int addPoint(SourceKind kind, const glm::vec3 &position, float strength, size_t budget = 100);
+    const Source &source(int id) const { return sources_[id]; }
+    size_t sources() const { return sources_.size(); }
+
+    /// \brief Sources inject into field, which is stepped with the simulation
+    /// and published with every snapshot, so while started other threads
+    /// query it with ScentField::sampleSnapshot(). Markers within it emit in
+    /// proportion to its concentration, the others at a rate set by their
+    /// strength. Set before start().
+    void setField(ScentField *field) { field_ = field; }
+
+    void initGL();
+    void finishGL();
+    /// \brief Run update() on a worker thread until stop().
+    void start();
+    void stop();
+    /// \brief Advance the simulation by dt in whole steps, the remainder
+    /// carries over to the next call. Not to be called while started.
+    void update(float dt);
+    /// \brief Draw the markers and particles near camera_pos in one instanced
+    /// call, sorted back to front, with a shader using shader/scent/vertex.glsl.
+    /// camera_pos also drives the emission level of detail.
+    void render(const glm::vec3 &camera_pos, const glm::mat4 &view, const glm::mat4 &projection);
+
+    /// \brief Sources within the cull distance at the last render().
+    size_t visibleSources() const { return visible_.size(); }
+
+    LodConfig lod_;
+    /// \brief Carries the particles, its mean follows the simulated wind.
+    /// Set up (scale, terrain) before start().
+    WindField wind_field_;
+
+private:
+    struct State {
+        /* simulated time of the snapshot */
+        double time = 0.0;
+        uint64_t first_id = 0;
+        /* position and intensity, and the source, oldest particle first */
+        std::vector<glm::vec4> particles;
+        std::vector<uint32_t> sources;
+    };
+    struct Visible {
+        uint32_t source;
+        /* markers stride is 1 << level */
+        int level;
+        /* emission scale, fades to 0 at the cull distance */
+        float fade;
+    };
+
+    /// \brief Sources within the cull distance of camera, with their detail.
+    void findVisible(const glm::vec3 &camera, std::vector<Visible> *visible, std::vector<uint32_t> *stamps,
+                     uint32_t *stamp) const;
+    void step();
+    void publish();
+    void work();
+
+    GLShader &shader_;
+    ScentBatch batch_;
+    std::vector<Source> sources_;
+    /* marker positions of all sources, emitter_begin_[s] is the first of s */
+    std::vector<glm::vec3> emitters_;
+    std::vector<uint32_t> emitter_begin_;
+    SpatialHash hash_;
+    bool hash_built_ = false;
+
+    /* simulation state, owned by whoever calls update() */
+    uint32_t seed_;
+    ScentParticles particles_;
+    std::vector<uint32_t> live_;
+    glm::vec3 wind_;
+    ScentField *field_ = nullptr;
+    std::vector<float> emitter_concentration_;
+    /* emitters within the field, the others emit by strength */
+    std::vector<uint8_t> emitter_in_field_;
+    /* emitters drawn to emit this step */
+    std::vector<uint8_t> emit_flags_;
+    std::vector<Visible> step_visible_;
+    std::vector<uint32_t> step_stamps_;
+    uint32_t step_stamp_ = 0;
+    uint64_t steps_ = 0;
+    float accumulator_ = 0.0f;
+    State back_;
+
+    /* render thread */
+    std::vector<Visible> visible_;
+    std::vector<uint32_t> render_stamps_;
+    uint32_t render_stamp_ = 0;
+
+    /* guards previous_, current_, camera_ and stop_ */
+    std::mutex mutex_;
+    std::condition_variable stop_cv_;
+    State previous_, current_;
+    glm::vec3 camera_ = glm::vec3(0.0f);
+    bool stop_ = false;
+    std::chrono::steady_clock::time_point start_;
+    std::thread worker_;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_SCENTMANAGER_H
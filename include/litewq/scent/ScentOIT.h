@@ -0,0 +1,69 @@
+#ifndef LITEWQ_SCENTOIT_H
+#define LITEWQ_SCENTOIT_H
+
+namespace litewq {
+
+class GLShader;
+
+/// \brief Weighted blended order independent transparency for scent sprites
+/// (McGuire and Bavoil 2013), so large clouds need no sorting.
+///
+/// Between begin() and end() sprites are drawn with shader/scent/oit_frag.glsl
+/// into two float targets, both with additive blending: the weighted
+/// premultiplied color with its weight, and -log(1 - alpha), whose sum gives
+/// the revealage without a multiplicative blend on a second target. end()
+/// resolves them over the target framebuffer in a full screen pass.
+///
+/// The scene depth is copied from the target, sprites are still hidden by
+/// opaque geometry.
+///
+/// Large clouds are bound by blending fill rate, so the targets can be a
+/// half or a quarter of the framebuffer size (setResolution()). The sprites
+/// are then depth tested against a point sampled copy of the scene depth at
+/// that size, and end() upsamples them with a bilateral filter: each of the
+/// four nearest low resolution texels is weighted by how close its depth is
+/// to the full resolution scene depth, so clouds stay sharp along the
+/// silhouettes of the geometry in front of them. OpenGL ES 3.0 cannot blit
+/// depth to a smaller target, GLES builds always accumulate at full size.
+///
+/// The float targets need EXT_color_buffer_half_float on OpenGL ES 3.0.
+class ScentOIT {
+public:
+    ScentOIT(GLShader &composite_shader) : composite_shader_(composite_shader) {}
+
+    void initGL(int width, int height);
+    void finishGL();
+    /// \brief Reallocate the targets when the framebuffer size changed.
+    void resize(int width, int height);
+    /// \brief Accumulate at 1 / divisor of the framebuffer size on each axis,
+    /// divisor is 1, 2 or 4.
+    void setResolution(int divisor);
+    int resolution() const { return divisor_; }
+
+    /// \brief Copy the depth of framebuffer target and start accumulating.
+    void begin(unsigned int target);
+    /// \brief Composite the accumulated sprites over framebuffer target.
+    void end(unsigned int target);
+
+    /* clip planes of the projection, the upsample compares linear depths */
+    float z_near_ = 0.1f, z_far_ = 100.0f;
+
+private:
+    void createTargets();
+    void deleteTargets();
+
+    GLShader &composite_shader_;
+    int width_ = 0, height_ = 0;
+    int divisor_ = 1;
+    /* size of the accumulation targets */
+    int low_width_ = 0, low_height_ = 0;
+    unsigned int FBO_ = 0;
+    unsigned int accum_tex_ = 0, reveal_tex_ = 0, depth_tex_ = 0;
+    /* full resolution copy of the scene depth, read by the upsample */
+    unsigned int scene_depth_FBO_ = 0, scene_depth_tex_ = 0;
+    unsigned int VAO_ = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_SCENTOIT_H
@@ -0,0 +1,68 @@
+#ifndef LITEWQ_SCENTPARTICLES_H
+#define LITEWQ_SCENTPARTICLES_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace litewq {
+
+class WindField;
+
+/// \brief Fixed capacity pool of scent particles, stored as a ring buffer of
+/// separate arrays (structure of arrays) so the update vectorizes.
+///
+/// Particles live in slots [head, head + size) modulo the capacity, oldest
+/// first. All particles age at the same rate, so the oldest one is always
+/// the next to expire: expiry pops the head and emitting into a full pool
+/// overwrites it, both in O(1).
+///
+/// Particles are numbered in emission order, the ids of the live ones are
+/// consecutive starting at firstId().
+class ScentParticles {
+public:
+    ScentParticles() = delete;
+    /// \brief capacity is the particle budget, lifetime the age in seconds a
+    /// particle expires at and decay the rate its intensity fades with.
+    ScentParticles(size_t capacity, float lifetime, float decay);
+
+    /// \brief tag is kept with the particle for the caller, e.g. its source.
+    void emit(const glm::vec3 &position, const glm::vec3 &velocity, float intensity, uint32_t tag = 0);
+    /// \brief Move every particle by its velocity plus the wind at its
+    /// position, age it, fade its intensity and drop the expired ones. Returns
+    /// how many expired, they were the oldest and keep their data until slots
+    /// are reused by emit().
+    size_t update(const WindField &wind, float dt);
+    void clear() { head_ = size_ = 0; }
+
+    size_t capacity() const { return x_.size(); }
+    size_t size() const { return size_; }
+    /// \brief Slot of the i-th oldest particle.
+    size_t slot(size_t i) const {
+        size_t s = head_ + i;
+        return s < capacity() ? s : s - capacity();
+    }
+    /// \brief Id of the oldest particle, the i-th oldest one has firstId() + i.
+    uint64_t firstId() const { return emitted_ - size_; }
+    glm::vec3 position(size_t slot) const { return {x_[slot], y_[slot], z_[slot]}; }
+
+    std::vector<float> x_, y_, z_;
+    std::vector<float> vx_, vy_, vz_;
+    std::vector<float> age_, intensity_;
+    std::vector<uint32_t> tag_;
+
+private:
+    /// \brief Advance the contiguous slots [begin, end).
+    void advance(size_t begin, size_t end, const WindField &wind, float dt, float fade);
+
+    /* wind at the particles, filled by update() */
+    std::vector<float> wind_x_, wind_y_, wind_z_;
+    size_t head_ = 0, size_ = 0;
+    uint64_t emitted_ = 0;
+    float lifetime_, decay_;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_SCENTPARTICLES_H
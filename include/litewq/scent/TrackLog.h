@@ -0,0 +1,139 @@
+#ifndef LITEWQ_TRACKLOG_H
+#define LITEWQ_TRACKLOG_H
+
+#include "litewq/math/BoundingBox.h"
+#include "litewq/math/Frustum.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace litewq {
+
+class GLShader;
+
+/// \brief History of where animals walked, as compact track samples in a
+/// uniform grid over the ground plane.
+///
+/// Every grid cell keeps its own log: a list of chunks of at most
+/// CHUNK_SAMPLES samples, filled in time order. Queries look up the cells
+/// they overlap and walk their chunks newest first, stopping at the first
+/// chunk older than the query's age limit, so they only touch fresh samples
+/// near the query no matter how long the world has been running.
+///
+/// Old tracks thin out: a chunk is decimated (every other sample of each
+/// animal dropped) after decimate_age, again after twice that and so on up
+/// to max_level times, and neighbouring chunks thinned as often are merged.
+/// Chunks past max_age are dropped.
+///
+/// Track markers are the samples themselves: render() copies the visible
+/// ones into a streamed buffer and draws them with one instanced call, with
+/// shader/scent/track_vertex.glsl.
+class TrackLog {
+public:
+    static constexpr size_t CHUNK_SAMPLES = 256;
+    static constexpr int MAX_SPECIES = 8;
+    static constexpr int ANY_SPECIES = -1;
+
+    /* 20 bytes, also the layout of the marker buffer */
+    struct Sample {
+        glm::vec3 position;
+        float time;
+        uint16_t animal;
+        uint8_t species;
+        /* decimation passes the sample survived */
+        uint8_t level;
+    };
+
+    struct Config {
+        /* an animal leaves a sample every spacing units it walks */
+        float spacing = 0.5f;
+        /* a chunk decimated level times is thinned again at decimate_age * 2^level */
+        float decimate_age = 30.0f;
+        int max_level = 3;
+        float max_age = 600.0f;
+        float cell_size = 16.0f;
+    };
+
+    TrackLog() : TrackLog(Config()) {}
+    explicit TrackLog(const Config &config);
+
+    /// \brief Record animal at position, if it walked spacing since its last
+    /// sample. Times must not decrease. Returns whether a sample was added.
+    bool append(uint16_t animal, uint8_t species, const glm::vec3 &position, float time);
+    /// \brief Decimate and drop the chunks that aged by now.
+    void update(float now);
+    void clear();
+
+    /// \brief Closest sample to position within radius on the ground plane,
+    /// at most max_age old, of species or ANY_SPECIES.
+    bool nearest(const glm::vec3 &position, float radius, float now, float max_age, int species,
+                 Sample *found) const;
+    /// \brief Samples at most max_age old inside frustum, appended to found.
+    void visible(const Frustum &frustum, float now, float max_age, std::vector<Sample> *found) const;
+
+    void initGL();
+    void finishGL();
+    /// \brief Draw a marker on the ground for every sample inside frustum,
+    /// fading out over max_age.
+    void render(GLShader &shader, const Frustum &frustum, float now, const glm::mat4 &view,
+                const glm::mat4 &projection);
+
+    size_t size() const { return size_; }
+    size_t cells() const { return cells_.size(); }
+
+    Config config_;
+    /* marker color of every species, alpha is the intensity of a fresh marker */
+    glm::vec4 species_color_[MAX_SPECIES];
+    float marker_size_ = 0.25f;
+
+private:
+    struct Chunk {
+        /* oldest first */
+        std::vector<Sample> samples;
+        float last_time = 0.0f;
+        int level = 0;
+    };
+    struct Cell {
+        Bounds3 bounds;
+        /* oldest first */
+        std::deque<Chunk> chunks;
+    };
+
+    glm::ivec2 cell(float x, float z) const {
+        return glm::ivec2(glm::floor(glm::vec2(x, z) / config_.cell_size));
+    }
+    static uint64_t key(const glm::ivec2 &cell) {
+        return uint64_t(uint32_t(cell.x)) << 32 | uint32_t(cell.y);
+    }
+    /// \brief Chunks of cell that may hold samples from oldest on, newest first.
+    template <typename Visit>
+    static void forChunks(const Cell &cell, float oldest, Visit &&visit) {
+        for (auto it = cell.chunks.rbegin(); it != cell.chunks.rend() && it->last_time >= oldest; ++it)
+            visit(*it);
+    }
+    void decimate(Chunk *chunk);
+    static void updateBounds(Cell *cell);
+
+    std::unordered_map<uint64_t, Cell> cells_;
+    /* cell coordinates the occupied cells span, lo > hi when there are none */
+    glm::ivec2 cell_lo_{std::numeric_limits<int>::max()}, cell_hi_{std::numeric_limits<int>::min()};
+    size_t size_ = 0;
+    /* last sample position of every animal, y is NaN before its first one */
+    std::vector<glm::vec3> last_position_;
+    std::vector<uint8_t> parity_;
+
+    /* render() scratch */
+    std::vector<Sample> markers_;
+    unsigned int VAO = 0, quad_VBO = 0, instance_VBO = 0;
+    /* markers the streamed buffer has room for */
+    size_t capacity_ = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_TRACKLOG_H
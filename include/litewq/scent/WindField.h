@@ -0,0 +1,74 @@
+#ifndef LITEWQ_WINDFIELD_H
+#define LITEWQ_WINDFIELD_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+namespace litewq {
+
+class GLShader;
+class Terrain;
+
+/// \brief Procedural wind: a mean drift plus divergence free gusts, bent to
+/// follow the terrain near the ground.
+///
+/// The gusts are the curl of a vector potential whose components are 3D
+/// gradient noise on a lattice of scale_ world units that tiles every PERIOD
+/// cells. The curl of any field has no divergence, so particles carried by
+/// the gusts swirl without bunching up or thinning out. The noise is frozen
+/// and drifts with the mean wind (advance()).
+///
+/// Within boundary_height_ of the ground the vertical speed is set so the
+/// horizontal wind runs along the slope instead of into it, fading out with
+/// the height above the ground.
+///
+/// The lattice hash is pure integer arithmetic without tables, so the batched
+/// velocity() vectorizes and shader/scent/update_vertex.glsl evaluates the
+/// same field on the GPU from the uniforms of setUniforms().
+class WindField {
+public:
+    /* lattice cells per tile side, a power of two */
+    static constexpr int PERIOD = 32;
+
+    WindField() = default;
+    /// \brief scale is the world size of a noise cell, strength the speed of
+    /// the gusts.
+    WindField(float scale, float strength);
+
+    /// \brief Bend the wind around the ground of terrain, nullptr for open air.
+    void setTerrain(const Terrain *terrain) { terrain_ = terrain; }
+    /// \brief Move the gusts along with the mean wind.
+    void advance(float dt);
+
+    glm::vec3 velocity(const glm::vec3 &position) const;
+    /// \brief Batched velocity over count points stored as separate arrays,
+    /// SIMD vectorized and split across threads for large batches.
+    void velocity(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                  size_t count) const;
+
+    /// \brief Upload the field to a shader evaluating it as in
+    /// shader/scent/update_vertex.glsl, the terrain heights are bound to
+    /// texture unit.
+    void setUniforms(GLShader &shader, unsigned int unit) const;
+
+    glm::vec3 mean_ = glm::vec3(0.0f);
+    float scale_ = 16.0f;
+    float strength_ = 1.0f;
+    float boundary_height_ = 8.0f;
+
+private:
+    /// \brief Gusts without the terrain, one block of at most BLOCK points.
+    void curl(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+              size_t count) const;
+    void deflect(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                 size_t count) const;
+
+    const Terrain *terrain_ = nullptr;
+    /* how far the noise drifted */
+    glm::vec3 offset_ = glm::vec3(0.0f);
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_WINDFIELD_H
@@ -0,0 +1,124 @@
+#ifndef LITEWQ_CASCADEDSHADOWMAP_H
+#define LITEWQ_CASCADEDSHADOWMAP_H
+
+#include "litewq/math/Frustum.h"
+
+#include <glm/glm.hpp>
+
+namespace litewq {
+
+class GLShader;
+
+struct ShadowConfig {
+    /* 1 to CascadedShadowMap::MAX_CASCADES */
+    int cascades = 4;
+    /* side of each cascade's depth map in texels */
+    int resolution = 2048;
+    /* practical split weight, 0 splits uniformly and 1 logarithmically */
+    float split_lambda = 0.8f;
+    /* shadows end here, or at the camera far plane if it is nearer */
+    float max_distance = 100.0f;
+    /* depth added towards the light, for casters outside the view */
+    float caster_distance = 200.0f;
+    /* static casters are re-rendered after the light turned this many degrees */
+    float cache_angle = 1.0f;
+    /* extra cascade radius, the camera can move this far before a refresh */
+    float cache_margin = 0.25f;
+    /* hardware compared lookups per fragment: 1 (2x2 texels), 4 (3x3 tent)
+     * or 9 (4x4 tent) */
+    int pcf_taps = 4;
+
+    static ShadowConfig desktop() { return ShadowConfig(); }
+    /* fewer and smaller cascades over a shorter distance */
+    static ShadowConfig mobile() {
+        ShadowConfig config;
+        config.cascades = 2;
+        config.resolution = 1024;
+        config.max_distance = 50.0f;
+        config.pcf_taps = 1;
+        return config;
+    }
+};
+
+/// \brief Directional light shadows split into cascades along the camera
+/// frustum, all stored as layers of one depth texture array.
+///
+/// Each cascade is an orthographic light projection around the bounding
+/// sphere of its slice of the view frustum. The sphere keeps the projection
+/// size constant while the camera turns, and its center is snapped to whole
+/// shadow texels so edges do not shimmer while the camera moves.
+///
+/// Static casters are rendered into a cached layer per cascade, fitted with
+/// a margin, that is only refreshed when the light turned past cache_angle
+/// or the camera left the margin. The near cascade refreshes right away,
+/// the far ones at most one per frame in turn. Each frame the dynamic
+/// casters are drawn on top of a copy of the static layer.
+class CascadedShadowMap {
+public:
+    static constexpr int MAX_CASCADES = 4;
+
+    CascadedShadowMap() = delete;
+    explicit CascadedShadowMap(const ShadowConfig &config);
+
+    void initGL();
+    void finishGL();
+
+    /// \brief Fit the cascades to the camera frustum of view and projection,
+    /// whose clip planes are z_near and z_far, for light shining from
+    /// direction light_dir (pointing towards the light), and decide which
+    /// cached static layers need a refresh.
+    void update(const glm::mat4 &view, const glm::mat4 &projection, float z_near, float z_far,
+                const glm::vec3 &light_dir);
+    /// \brief Whether the static casters of a cascade must be drawn this frame.
+    bool refreshing(int cascade) const { return refresh_[cascade]; }
+    /// \brief Make the static layer of a cascade the depth render target,
+    /// clear it and set the viewport to it.
+    void bindStatic(int cascade) const;
+    /// \brief Composite a cascade: copy its static layer into the sampled
+    /// layer and make that the render target for the dynamic casters. The
+    /// copy is skipped when neither side changed. Returns has_dynamic.
+    /// Rebind the default framebuffer and viewport afterwards.
+    bool bindDynamic(int cascade, bool has_dynamic);
+    /// \brief Bind the depth array to texture unit and set the cascade uniforms
+    /// of a shader using shadow/shadowmap_frag.glsl.
+    void bind(GLShader *shader, unsigned int unit) const;
+
+    int cascades() const { return config_.cascades; }
+    const glm::mat4 &lightMatrix(int cascade) const { return light_matrices_[cascade]; }
+    /// \brief Light frustum of a cascade, casters outside of it can be skipped.
+    const Frustum &frustum(int cascade) const { return frusta_[cascade]; }
+    float split(int cascade) const { return splits_[cascade]; }
+    /// \brief Static layers refreshed by the last update().
+    int refreshed() const;
+
+    ShadowConfig config_;
+
+private:
+    void fit(int cascade, const glm::vec3 &center, float radius, const glm::mat4 &light_view);
+
+    glm::mat4 light_matrices_[MAX_CASCADES];
+    Frustum frusta_[MAX_CASCADES];
+    /* view distance where each cascade ends */
+    float splits_[MAX_CASCADES];
+    /* world size of one shadow texel and of the light space depth range */
+    float texel_size_[MAX_CASCADES];
+    float depth_range_[MAX_CASCADES];
+
+    /* what the static layer was rendered for */
+    bool cached_[MAX_CASCADES];
+    glm::vec3 cached_center_[MAX_CASCADES];
+    float cached_radius_[MAX_CASCADES];
+    glm::vec3 cached_light_dir_[MAX_CASCADES];
+    bool refresh_[MAX_CASCADES];
+    /* the sampled layer holds dynamic casters on top of the static ones */
+    bool composited_[MAX_CASCADES];
+    int next_far_ = 1;
+
+    /* static_tex_ holds the cached layers, depth_tex_ is sampled */
+    unsigned int FBO = 0, copy_FBO = 0;
+    unsigned int depth_tex_ = 0, static_tex_ = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_CASCADEDSHADOWMAP_H
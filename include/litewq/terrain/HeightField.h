@@ -0,0 +1,142 @@
+#ifndef LITEWQ_HEIGHTFIELD_H
+#define LITEWQ_HEIGHTFIELD_H
+
+#include "litewq/math/BoundingBox.h"
+
+#include <glm/glm.hpp>
+#include <glm/packing.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace litewq {
+
+/// \brief 16-bit height samples of a heightmap and the data derived from them:
+/// per texel normals and tangents, a min/max pyramid over the height cells and
+/// world space bounds of fixed size tiles.
+///
+/// Preprocessing runs once (OpenMP over rows, SIMD over columns), the result
+/// is cached as "<heightmap>.terrain" and reused while the source image and
+/// the height mapping stay the same.
+///
+/// Texel (row, col) lies at world (row - rows / 2, height, col - cols / 2),
+/// cell (row, col) is the quad between texels (row, col) and (row + 1, col + 1).
+class HeightField {
+public:
+    /* quads per side of a bounding tile, a power of two */
+    static constexpr int TILE_SIZE = 64;
+
+    struct MinMax {
+        uint16_t min, max;
+    };
+
+    /* ray parameter, world position / normal of the hit and the cell hit */
+    struct RayHit {
+        float t;
+        glm::vec3 position;
+        glm::vec3 normal;
+        int row, col;
+    };
+
+    HeightField() = delete;
+    /// \brief height = height_scale * pixel + height_offset, pixel in [0, 255].
+    /// 16-bit heightmaps keep their precision, their pixel is sample / 257.
+    HeightField(const std::string &heightmap, float height_scale, float height_offset);
+
+    /// \brief Replace the rows x cols samples from (row, col), row major, and
+    /// re-derive the normals, tangents, pyramid levels and tiles they touch.
+    /// Edits live in memory only, the cache keeps describing the source image.
+    void updateSamples(int row, int col, int rows, int cols, const uint16_t *samples);
+    const uint16_t *samples() const { return samples_.data(); }
+
+    float sampleToHeight(float sample) const {
+        return height_scale_ * sample / 257.0f + height_offset_;
+    }
+    /// \brief Level 0 has one entry per cell, each level halves both sides
+    /// until a single root cell is left. Levels above the root repeat it.
+    int levels() const { return int(pyramid_.size()); }
+    glm::ivec2 levelDims(int level) const {
+        return level_dims_[std::min(level, levels() - 1)];
+    }
+    MinMax minMax(int level, int row, int col) const {
+        level = std::min(level, levels() - 1);
+        return pyramid_[level][row * level_dims_[level].y + col];
+    }
+    glm::vec3 normal(int row, int col) const {
+        return glm::vec3(glm::unpackSnorm4x8(normals_[row * cols_ + col]));
+    }
+    glm::vec4 tangent(int row, int col) const { return glm::unpackSnorm4x8(tangents_[row * cols_ + col]); }
+
+    /// \brief Bilinear ground height / normal at world (x, z), positions
+    /// outside the heightmap are clamped to its border. Inline, the batched
+    /// versions run the same code per point.
+    float heightAt(float x, float z) const {
+        int i, j;
+        float u, v;
+        worldToCell(x, z, rows_, cols_, &i, &j, &u, &v);
+        const uint16_t *s = &samples_[i * cols_ + j];
+        return sampleToHeight((1 - u) * ((1 - v) * s[0] + v * s[1]) + u * ((1 - v) * s[cols_] + v * s[cols_ + 1]));
+    }
+    glm::vec3 normalAt(float x, float z) const {
+        int i, j;
+        float u, v;
+        worldToCell(x, z, rows_, cols_, &i, &j, &u, &v);
+        return glm::normalize((1 - u) * ((1 - v) * normal(i, j) + v * normal(i, j + 1)) +
+                              u * ((1 - v) * normal(i + 1, j) + v * normal(i + 1, j + 1)));
+    }
+    /// \brief Batched heightAt over count points stored as separate x and z
+    /// arrays, SIMD vectorized and split across threads for large batches.
+    void heightAt(const float *x, const float *z, float *heights, size_t count) const;
+    void normalAt(const float *x, const float *z, glm::vec3 *normals, size_t count) const;
+    /// \brief Batched heightAt that also returns the gradient of the bilinear
+    /// surface, dh/dx and dh/dz, zero across the clamped border.
+    void slopeAt(const float *x, const float *z, float *heights, float *dhdx, float *dhdz, size_t count) const;
+
+    /// \brief First hit of the ray origin + t * direction, t in [0, t_max], with
+    /// the bilinear surface. Walks the min/max pyramid top down and only
+    /// intersects the cells whose height range the ray passes through.
+    bool intersect(const glm::vec3 &origin, const glm::vec3 &direction, float t_max, RayHit *hit) const;
+    /// \brief Batched intersect split across threads, misses get t = infinity.
+    /// Returns the number of hits.
+    size_t intersect(const glm::vec3 *origins, const glm::vec3 *directions, float t_max,
+                     RayHit *hits, size_t count) const;
+
+    int rows_ = 0, cols_ = 0;
+    float height_scale_, height_offset_;
+    /* world bounds of TILE_SIZE x TILE_SIZE cells, row major */
+    std::vector<Bounds3> tiles_;
+    glm::ivec2 tile_dims_;
+
+private:
+    /* locate the cell under world (x, z) and the fraction inside it */
+    static void worldToCell(float x, float z, int rows, int cols, int *row, int *col, float *frac_row,
+                            float *frac_col) {
+        float r = std::min(std::max(x + rows / 2.0f, 0.0f), float(rows - 1));
+        float c = std::min(std::max(z + cols / 2.0f, 0.0f), float(cols - 1));
+        *row = std::min(int(r), rows - 2);
+        *col = std::min(int(c), cols - 2);
+        *frac_row = r - *row;
+        *frac_col = c - *col;
+    }
+    void allocate();
+    /// \brief Re-derive everything touched by samples in [row0, row1] x [col0, col1].
+    void refresh(int row0, int col0, int row1, int col1);
+    void build(int row0, int col0, int row1, int col1);
+    void buildTiles(int row0, int col0, int row1, int col1);
+    bool readCache(const std::string &cache, const std::string &heightmap);
+    void writeCache(const std::string &cache, const std::string &heightmap) const;
+
+    /* the derived data below is only rebuilt through updateSamples() */
+    std::vector<uint16_t> samples_;
+    /* snorm 4x8 packed, tangents point along +row with handedness in w */
+    std::vector<uint32_t> normals_;
+    std::vector<uint32_t> tangents_;
+    std::vector<std::vector<MinMax>> pyramid_;
+    std::vector<glm::ivec2> level_dims_;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_HEIGHTFIELD_H
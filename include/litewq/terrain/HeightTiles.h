@@ -0,0 +1,70 @@
+#ifndef LITEWQ_HEIGHTTILES_H
+#define LITEWQ_HEIGHTTILES_H
+
+#include "litewq/utils/MappedFile.h"
+
+#include <cstdint>
+#include <string>
+
+namespace litewq {
+
+/// \brief A heightmap cut into fixed size tiles of 16-bit samples, stored in
+/// a single file that is memory mapped at runtime.
+///
+/// A tile covers tile_size x tile_size height cells, i.e. (tile_size + 1)^2
+/// samples: neighbouring tiles share their border samples, so a tile can be
+/// sampled bilinearly on its own. Samples past the heightmap border repeat
+/// the last row / column. Every tile starts on a page boundary of the file
+/// so reading it touches no pages of its neighbours.
+///
+/// The file is produced offline by write() (see the litewq_tiler tool),
+/// since huge heightmaps do not fit in memory next to the running app.
+class HeightTiles {
+public:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        /* samples of the source heightmap */
+        int32_t rows, cols;
+        int32_t tile_size;
+        int32_t tile_rows, tile_cols;
+        /* bytes between consecutive tiles and offset of the first one */
+        uint32_t tile_stride;
+        uint64_t data_offset;
+    };
+    /* per tile sample range, stored after the header */
+    struct MinMax {
+        uint16_t min, max;
+    };
+
+    HeightTiles() = default;
+    explicit HeightTiles(const std::string &path) { open(path); }
+
+    /// \brief Cut heightmap into tiles of tile_size cells and write them to output.
+    static bool write(const std::string &heightmap, const std::string &output, int tile_size);
+
+    bool open(const std::string &path);
+    bool isOpen() const { return header_ != nullptr; }
+
+    const Header &header() const { return *header_; }
+    int tileSamples() const { return header_->tile_size + 1; }
+    size_t tileBytes() const { return size_t(tileSamples()) * tileSamples() * sizeof(uint16_t); }
+    /// \brief Row major samples of a tile, pages are read in on first access.
+    const uint16_t *tile(int tile_row, int tile_col) const {
+        return reinterpret_cast<const uint16_t *>(
+            file_.data() + header_->data_offset +
+            uint64_t(tile_row * header_->tile_cols + tile_col) * header_->tile_stride);
+    }
+    MinMax minMax(int tile_row, int tile_col) const {
+        return min_max_[tile_row * header_->tile_cols + tile_col];
+    }
+
+private:
+    MappedFile file_;
+    const Header *header_ = nullptr;
+    const MinMax *min_max_ = nullptr;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_HEIGHTTILES_H
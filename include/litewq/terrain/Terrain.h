@@ -0,0 +1,127 @@
+#ifndef LITEWQ_TERRAIN_H
+#define LITEWQ_TERRAIN_H
+
+#include "litewq/math/BoundingBox.h"
+#include "litewq/math/Frustum.h"
+#include "litewq/terrain/HeightField.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace litewq {
+
+class GLShader;
+class TerrainPager;
+
+/// \brief Heightmap terrain rendered with continuous distance-dependent LOD (CDLOD).
+///
+/// The heightmap is covered by a quadtree, every selected node is drawn with
+/// the same GRID_DIM x GRID_DIM patch whose heights are fetched in the vertex
+/// shader. A node's LOD only depends on its distance to the camera, and
+/// vertices morph into the next coarser grid before the LOD switches, so the
+/// draw calls and triangles stay bounded by the view range rather than by the
+/// heightmap resolution.
+///
+/// Heights are kept as 16-bit samples, both on the CPU (see HeightField) and
+/// in an R16 texture, normals are central differences of the height texture.
+/// Editing terrain is a texture sub-upload, there is no vertex data to rebuild.
+///
+/// A paged terrain is drawn from the tiles a TerrainPager keeps resident
+/// instead: the vertex shader looks each texel's tile up in the page table
+/// and samples its layer of the page array, node bounds come from the
+/// per-tile ranges of the tiles file, and nothing past the pager's radius
+/// is drawn. No HeightField is loaded then, heightField(), heightTexture()
+/// and updateHeights() are for heightmap terrains only.
+class Terrain {
+public:
+    /* patch resolution in quads, must be even for the quadrant split */
+    static constexpr int GRID_DIM = 32;
+    /* HeightField min/max pyramid level of a leaf node */
+    static constexpr int LEAF_LEVEL = 5;
+    static constexpr int LOD_COUNT = 6;
+    /* view range of the finest LOD, each coarser LOD doubles it */
+    static constexpr float LOD_DISTANCE = 80.0f;
+    /* fraction of a LOD range after which vertices start to morph */
+    static constexpr float MORPH_START = 0.66f;
+
+    Terrain() = delete;
+    /// \brief height = height_scale * pixel + height_offset, pixel in [0, 255].
+    /// 16-bit heightmaps keep their precision, their pixel is sample / 257.
+    Terrain(const std::string &heightmap, float height_scale, float height_offset);
+    /// \brief Terrain streamed by pager, which must outlive it and be updated
+    /// and uploaded every frame before select().
+    explicit Terrain(TerrainPager *pager);
+
+    void initGL();
+    void finishGL();
+
+    /// \brief Choose the nodes to draw, LOD by distance to lod_origin and
+    /// nodes outside frustum culled.
+    void select(const glm::vec3 &lod_origin, const Frustum &frustum);
+    /// \brief Draw the last selection with a terrain shader.
+    void render(GLShader *shader) const;
+
+    /// \brief Overwrite a block of 16-bit samples (row major, cols wide) and
+    /// re-upload only that block.
+    void updateHeights(int row, int col, int rows, int cols, const uint16_t *samples);
+
+    /// \brief Ground height / normal at world (x, z), the same surface the
+    /// terrain is drawn with. Also see the batched HeightField queries.
+    float heightAt(float x, float z) const {
+        return pager_ ? pagedHeightAt(x, z) : height_field_->heightAt(x, z);
+    }
+    glm::vec3 normalAt(float x, float z) const {
+        return pager_ ? pagedNormalAt(x, z) : height_field_->normalAt(x, z);
+    }
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    bool paged() const { return pager_ != nullptr; }
+    const HeightField &heightField() const { return *height_field_; }
+    /// \brief R16 height texture, valid after initGL().
+    unsigned int heightTexture() const { return height_tex_; }
+    size_t selectedNodes() const { return selection_.size(); }
+
+    /* the page array and page table of a paged terrain use the next two units */
+    unsigned int height_tex_unit_ = 2;
+
+private:
+    struct SelectedNode {
+        int lod;
+        int row, col;
+        /* 0-3 child quadrant drawn at this node's LOD, 4 the whole node */
+        int part;
+    };
+
+    float pagedHeightAt(float x, float z) const;
+    glm::vec3 pagedNormalAt(float x, float z) const;
+    float sampleToHeight(float sample) const { return height_scale_ * sample / 257.0f + height_offset_; }
+    int nodeSize(int lod) const { return GRID_DIM << lod; }
+    /// \brief Quadtree dimensions of a HeightField pyramid level.
+    glm::ivec2 levelDims(int level) const;
+    Bounds3 nodeBound(int lod, int row, int col) const;
+    bool selectNode(int lod, int row, int col, bool root);
+
+    /* exactly one of them is set */
+    std::unique_ptr<HeightField> height_field_;
+    TerrainPager *pager_ = nullptr;
+    int rows_, cols_;
+    float height_scale_, height_offset_;
+    float ranges_[LOD_COUNT];
+
+    glm::vec3 lod_origin_;
+    Frustum frustum_;
+    std::vector<SelectedNode> selection_;
+
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int height_tex_ = 0;
+    unsigned int quadrant_indices_ = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_TERRAIN_H
@@ -0,0 +1,126 @@
+#ifndef LITEWQ_TERRAINPAGER_H
+#define LITEWQ_TERRAINPAGER_H
+
+#include "litewq/terrain/HeightTiles.h"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace litewq {
+
+class GLShader;
+
+/// \brief Streams the tiles of a HeightTiles file around the camera, so the
+/// world can be much larger than the memory set aside for heights.
+///
+/// A fixed number of slots, derived from the memory budget, holds the
+/// resident tiles: a CPU copy for queries and one layer of an R16 texture
+/// array for rendering. update() requests the tiles within a radius of the
+/// camera, nearest first. A worker thread copies them out of the mapped file,
+/// so page faults never block the frame, and upload() moves finished tiles
+/// to the GPU. When slots run out the least recently wanted tile is evicted.
+///
+/// pageTable maps a tile to its layer, -1 when the tile is not resident.
+class TerrainPager {
+public:
+    struct Stats {
+        /* tiles wanted by update() and how many of them were resident */
+        uint64_t requests = 0, hits = 0;
+        uint64_t loads = 0, evictions = 0;
+        /* wanted tiles that found no free slot within the budget */
+        uint64_t rejected = 0;
+        /* acquire() calls that had to wait for a tile, and for how long */
+        uint64_t stalls = 0;
+        double stall_time = 0.0;
+        /* time the worker spent reading tiles */
+        double load_time = 0.0;
+
+        float hitRate() const { return requests ? float(hits) / float(requests) : 1.0f; }
+    };
+
+    TerrainPager() = delete;
+    /// \brief height = height_scale * pixel + height_offset as in HeightField,
+    /// budget_bytes bounds the resident tiles (per copy, CPU and GPU), radius
+    /// is the world distance around the camera kept resident.
+    TerrainPager(const std::string &tiles, float height_scale, float height_offset,
+                 size_t budget_bytes, float radius);
+    ~TerrainPager();
+    TerrainPager(const TerrainPager &) = delete;
+    TerrainPager &operator=(const TerrainPager &) = delete;
+
+    void initGL();
+    void finishGL();
+
+    /// \brief Request the tiles around center and evict what is no longer needed.
+    void update(const glm::vec3 &center);
+    /// \brief Upload at most max_tiles loaded tiles to the texture array (GL thread).
+    void upload(int max_tiles = 8);
+    /// \brief Samples of a tile, loaded right away when it is not resident.
+    /// The pointer stays valid until the next update().
+    const uint16_t *acquire(int tile_row, int tile_col);
+
+    /// \brief Bilinear height at world (x, z), same mapping as HeightField.
+    /// Blocks (and counts a stall) when the tile is not resident yet.
+    float heightAt(float x, float z);
+
+    /// \brief Bind the texture array to unit and the page table to unit + 1.
+    void bind(GLShader *shader, unsigned int unit) const;
+
+    float sampleToHeight(float sample) const { return height_scale_ * sample / 257.0f + height_offset_; }
+    float heightScale() const { return height_scale_; }
+    float heightOffset() const { return height_offset_; }
+    float radius() const { return radius_; }
+
+    const HeightTiles &tiles() const { return tiles_; }
+    int slots() const { return int(slots_.size()); }
+    Stats stats() const;
+    void resetStats();
+
+private:
+    enum class SlotState { FREE, QUEUED, LOADING, LOADED, RESIDENT };
+
+    struct Slot {
+        SlotState state = SlotState::FREE;
+        /* tile_row * tile_cols + tile_col, -1 when free */
+        int tile = -1;
+        /* frame the tile was last wanted in */
+        uint64_t last_used = 0;
+        std::vector<uint16_t> samples;
+    };
+
+    void work();
+    int findSlot(bool keep_wanted);
+    void evict(int slot);
+    void request(int tile, bool urgent);
+
+    HeightTiles tiles_;
+    float height_scale_, height_offset_;
+    float radius_;
+
+    /* guards slots_ state, tile_slot_, queue_, page_table_ and stats_ */
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_, loaded_cv_;
+    std::vector<Slot> slots_;
+    std::unordered_map<int, int> tile_slot_;
+    std::deque<int> queue_;
+    std::vector<int16_t> page_table_;
+    bool page_table_dirty_ = true;
+    uint64_t frame_ = 0;
+    Stats stats_;
+    bool stop_ = false;
+    std::thread worker_;
+
+    unsigned int pages_tex_ = 0, page_table_tex_ = 0;
+};
+
+} // end namespace litewq
+
+#endif // LITEWQ_TERRAINPAGER_H
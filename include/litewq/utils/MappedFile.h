@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace litewq {
+
+
+/// \brief Read-only memory mapping of a whole file, pages are faulted in
+/// by the OS on first access.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path) { open(path); }
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    const unsigned char *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isOpen() const { return data_ != nullptr; }
+
+private:
+    const unsigned char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
+
+} // end namespace litewq
@@ -0,0 +1,607 @@
+#include "litewq/bench/Bench.h"
+#include "litewq/math/BVH.h"
+#include "litewq/math/Shape.h"
+#include "litewq/mesh/TriMesh.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLTimer.h"
+#include "litewq/scent/ScentBatch.h"
+#include "litewq/scent/ScentGPU.h"
+#include "litewq/scent/ScentOIT.h"
+#include "litewq/scent/TrackLog.h"
+#include "litewq/scent/WindField.h"
+#include "litewq/terrain/HeightField.h"
+#include "litewq/terrain/Terrain.h"
+#include "litewq/utils/Loader.h"
+#include "litewq/utils/logging.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace litewq;
+using namespace std::chrono;
+
+void litewq::RunBenchmarks() {
+    Terrain terrain(Loader::getAssetPath("tex/iceland_heightmap.png"), 0.2f, -20.5f);
+    BenchTerrainRays(terrain.heightField(), 100000);
+    BenchWind(terrain, 100000);
+    BenchWind(terrain, 1000000);
+    BenchScentSort(10000);
+    BenchScentSort(100000);
+    BenchTrackQueries(100);
+    BenchTrackQueries(1000);
+}
+
+void litewq::RunGLBenchmarks() {
+    /* the models load their textures, so they wait for the context */
+    auto wolf = TriMesh::from_obj(Loader::getAssetPath("model/wolf/wolf.obj"));
+    auto tree = TriMesh::from_obj(Loader::getAssetPath("model/tree/Tree1.obj"));
+    auto sphere = TriMesh::create_sphere(1.0f, 256, 128);
+    BenchBVHCollision("wolf", static_cast<TriMesh *>(wolf.get()), 1000000);
+    BenchBVHCollision("tree", static_cast<TriMesh *>(tree.get()), 1000000);
+    BenchBVHCollision("sphere", static_cast<TriMesh *>(sphere.get()), 1000000);
+    BenchBVHRays("wolf", static_cast<TriMesh *>(wolf.get()), 1000000);
+    BenchBVHRays("tree", static_cast<TriMesh *>(tree.get()), 1000000);
+    BenchBVHRays("sphere", static_cast<TriMesh *>(sphere.get()), 1000000);
+    Terrain terrain(Loader::getAssetPath("tex/iceland_heightmap.png"), 0.2f, -20.5f);
+    terrain.initGL();
+    BenchScentWindGPU(terrain, 200000);
+    terrain.finishGL();
+    BenchScentTransparency(10000);
+    BenchScentTransparency(100000);
+    BenchScentResolution(100000);
+}
+
+/* particles in a box in front of a camera at the origin looking down -z */
+static void fillScentBatch(ScentBatch *batch, size_t particles) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    batch->clear();
+    for (size_t n = 0; n < particles; ++n)
+        batch->add(glm::vec3(uniform(rng) * 20.0f, uniform(rng) * 10.0f, -30.0f + uniform(rng) * 25.0f),
+                   0.1f, glm::vec4(0.95f, 0.54f, 0.21f, 0.5f));
+}
+
+static const glm::mat4 BENCH_VIEW = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+void litewq::BenchScentSort(size_t particles) {
+    constexpr int ROUNDS = 20;
+    ScentBatch batch;
+    fillScentBatch(&batch, particles);
+    const std::vector<ScentBatch::Instance> instances = batch.instances_;
+
+    double radix = 0.0, reference = 0.0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        batch.instances_ = instances;
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        batch.sort(BENCH_VIEW);
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        batch.instances_ = instances;
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        std::vector<std::pair<float, uint32_t>> depths(particles);
+        for (size_t n = 0; n < particles; ++n)
+            depths[n] = {(BENCH_VIEW * glm::vec4(instances[n].position, 1.0f)).z, uint32_t(n)};
+        std::sort(depths.begin(), depths.end());
+        for (size_t n = 0; n < particles; ++n)
+            batch.instances_[n] = instances[depths[n].second];
+        high_resolution_clock::time_point t3 = high_resolution_clock::now();
+        radix += duration<double, std::milli>(t1 - t0).count();
+        reference += duration<double, std::milli>(t3 - t2).count();
+    }
+    LOG(INFO) << "Scent sort: " << particles << " particles, radix " << radix / ROUNDS
+              << " ms, std::sort " << reference / ROUNDS << " ms";
+}
+
+void litewq::BenchScentTransparency(size_t particles) {
+    constexpr int WIDTH = 1280, HEIGHT = 720, FRAMES = 30;
+    GLShader blend_shader(Loader::readFromRelative("shader/scent/vertex.glsl"),
+                          Loader::readFromRelative("shader/scent/frag.glsl"));
+    GLShader oit_shader(Loader::readFromRelative("shader/scent/vertex.glsl"),
+                        Loader::readFromRelative("shader/scent/oit_frag.glsl"));
+    GLShader composite_shader(Loader::readFromRelative("shader/scent/composite_vertex.glsl"),
+                              Loader::readFromRelative("shader/scent/composite_frag.glsl"));
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), float(WIDTH) / HEIGHT, 0.1f, 100.0f);
+
+    /* stand-in for the scene: a cleared color and depth target */
+    unsigned int FBO, color_rbo, depth_rbo;
+    glGenRenderbuffers(1, &color_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+    glGenRenderbuffers(1, &depth_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WIDTH, HEIGHT);
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_rbo);
+    CHECK_EQ(glCheckFramebufferStatus(GL_FRAMEBUFFER), GL_FRAMEBUFFER_COMPLETE) << "Incomplete bench framebuffer";
+
+    ScentBatch batch;
+    batch.initGL();
+    ScentOIT oit(composite_shader);
+    oit.initGL(WIDTH, HEIGHT);
+    GLTimer sorted_timer, oit_timer;
+    sorted_timer.initGL();
+    oit_timer.initGL();
+    fillScentBatch(&batch, particles);
+    glEnable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    /* the timers report LATENCY frames late, run that many more */
+    double sort_ms = 0.0;
+    for (int frame = 0; frame < FRAMES + GLTimer::LATENCY; ++frame) {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, WIDTH, HEIGHT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        batch.sort(BENCH_VIEW);
+        if (frame < FRAMES)
+            sort_ms += duration<double, std::milli>(high_resolution_clock::now() - t0).count();
+        sorted_timer.begin();
+        batch.render(blend_shader, BENCH_VIEW, projection);
+        sorted_timer.end();
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        oit_timer.begin();
+        oit.begin(FBO);
+        batch.render(oit_shader, BENCH_VIEW, projection);
+        oit.end(FBO);
+        oit_timer.end();
+    }
+    glFinish();
+    LOG(INFO) << "Scent transparency: " << particles << " particles at " << WIDTH << "x" << HEIGHT
+              << ", sorted blend " << sorted_timer.average() << " ms GPU + " << sort_ms / FRAMES
+              << " ms sort, weighted blended OIT " << oit_timer.average() << " ms GPU";
+
+    sorted_timer.finishGL();
+    oit_timer.finishGL();
+    oit.finishGL();
+    batch.finishGL();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(1, &color_rbo);
+    glDeleteRenderbuffers(1, &depth_rbo);
+}
+
+void litewq::BenchScentResolution(size_t particles) {
+    constexpr int WIDTH = 1920, HEIGHT = 1080, FRAMES = 30;
+    constexpr int DIVISORS[3] = {1, 2, 4};
+    GLShader oit_shader(Loader::readFromRelative("shader/scent/vertex.glsl"),
+                        Loader::readFromRelative("shader/scent/oit_frag.glsl"));
+    GLShader composite_shader(Loader::readFromRelative("shader/scent/composite_vertex.glsl"),
+                              Loader::readFromRelative("shader/scent/composite_frag.glsl"));
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), float(WIDTH) / HEIGHT, 0.1f, 100.0f);
+
+    /* stand-in for the scene: a cleared color and depth target */
+    unsigned int FBO, color_rbo, depth_rbo;
+    glGenRenderbuffers(1, &color_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+    glGenRenderbuffers(1, &depth_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WIDTH, HEIGHT);
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_rbo);
+    CHECK_EQ(glCheckFramebufferStatus(GL_FRAMEBUFFER), GL_FRAMEBUFFER_COMPLETE) << "Incomplete bench framebuffer";
+
+    ScentBatch batch;
+    batch.initGL();
+    fillScentBatch(&batch, particles);
+    ScentOIT oit(composite_shader);
+    oit.initGL(WIDTH, HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+
+    double ms[3];
+    for (int d = 0; d < 3; ++d) {
+        oit.setResolution(DIVISORS[d]);
+        GLTimer timer;
+        timer.initGL();
+        /* the timers report LATENCY frames late, run that many more */
+        for (int frame = 0; frame < FRAMES + GLTimer::LATENCY; ++frame) {
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glViewport(0, 0, WIDTH, HEIGHT);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            timer.begin();
+            oit.begin(FBO);
+            batch.render(oit_shader, BENCH_VIEW, projection);
+            oit.end(FBO);
+            timer.end();
+        }
+        glFinish();
+        ms[d] = timer.average();
+        timer.finishGL();
+    }
+    LOG(INFO) << "Scent resolution: " << particles << " particles at " << WIDTH << "x" << HEIGHT << ", full "
+              << ms[0] << " ms GPU, half " << ms[1] << " ms GPU, quarter " << ms[2] << " ms GPU";
+
+    oit.finishGL();
+    batch.finishGL();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(1, &color_rbo);
+    glDeleteRenderbuffers(1, &depth_rbo);
+}
+
+void litewq::BenchTerrainRays(const HeightField &height_field, size_t rays) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    const float half_rows = height_field.rows_ / 2.0f - 1.0f, half_cols = height_field.cols_ / 2.0f - 1.0f;
+    auto groundPoint = [&](float above) {
+        glm::vec3 p(uniform(rng) * half_rows, 0.0f, uniform(rng) * half_cols);
+        p.y = height_field.heightAt(p.x, p.z) + above;
+        return p;
+    };
+
+    std::vector<glm::vec3> origins(rays), directions(rays);
+    std::vector<HeightField::RayHit> hits(rays);
+    auto run = [&](const char *name, float t_max) {
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        size_t found = 0;
+        for (size_t n = 0; n < rays; ++n)
+            found += height_field.intersect(origins[n], directions[n], t_max, &hits[n]);
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        height_field.intersect(origins.data(), directions.data(), t_max, hits.data(), rays);
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        double single = duration<double>(t1 - t0).count(), batched = duration<double>(t2 - t1).count();
+        LOG(INFO) << "Terrain rays (" << name << "): " << rays << " rays, "
+                  << 100.0 * found / rays << "% hit, "
+                  << rays / single * 1e-6 << " Mrays/s one thread, "
+                  << rays / batched * 1e-6 << " Mrays/s batched";
+    };
+
+    /* camera picking, from eye height down to the horizon */
+    for (size_t n = 0; n < rays; ++n) {
+        origins[n] = groundPoint(2.0f);
+        directions[n] = glm::normalize(glm::vec3(uniform(rng), -0.5f * std::abs(uniform(rng)), uniform(rng)));
+    }
+    run("picking", std::numeric_limits<float>::infinity());
+
+    /* line of sight between two points above the ground, t in [0, 1] */
+    for (size_t n = 0; n < rays; ++n) {
+        origins[n] = groundPoint(1.0f);
+        glm::vec3 target = origins[n] + glm::vec3(uniform(rng), 0.0f, uniform(rng)) * 100.0f;
+        target.y = height_field.heightAt(target.x, target.z) + 1.0f;
+        directions[n] = target - origins[n];
+    }
+    run("line of sight", 1.0f);
+
+    /* particles dropping onto the ground */
+    for (size_t n = 0; n < rays; ++n) {
+        origins[n] = groundPoint(5.0f);
+        directions[n] = glm::vec3(0.0f, -1.0f, 0.0f);
+    }
+    run("drop", std::numeric_limits<float>::infinity());
+}
+
+void litewq::BenchWind(const Terrain &terrain, size_t particles) {
+    constexpr int ROUNDS = 10;
+    const HeightField &height_field = terrain.heightField();
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f), above(0.0f, 12.0f);
+    std::vector<float> x(particles), y(particles), z(particles);
+    for (size_t n = 0; n < particles; ++n) {
+        x[n] = uniform(rng) * (height_field.rows_ / 2.0f - 1.0f);
+        z[n] = uniform(rng) * (height_field.cols_ / 2.0f - 1.0f);
+        y[n] = height_field.heightAt(x[n], z[n]) + above(rng);
+    }
+    std::vector<float> vx(particles), vy(particles), vz(particles);
+
+    WindField wind(16.0f, 1.0f);
+    wind.mean_ = glm::vec3(1.0f, 0.0f, 0.5f);
+    auto rate = [&](auto &&run) {
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        for (int round = 0; round < ROUNDS; ++round)
+            run();
+        double ms = duration<double, std::milli>(high_resolution_clock::now() - t0).count();
+        return double(particles) * ROUNDS / ms;
+    };
+    double single = rate([&] {
+        for (size_t n = 0; n < particles; ++n) {
+            glm::vec3 v = wind.velocity(glm::vec3(x[n], y[n], z[n]));
+            vx[n] = v.x;
+            vy[n] = v.y;
+            vz[n] = v.z;
+        }
+    });
+    double batched = rate([&] { wind.velocity(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), particles); });
+    wind.setTerrain(&terrain);
+    double terrain_batched =
+        rate([&] { wind.velocity(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), particles); });
+    LOG(INFO) << "Wind: " << particles << " particles, " << single << " particles/ms one at a time, "
+              << batched << " particles/ms batched, " << terrain_batched << " particles/ms batched over terrain";
+}
+
+void litewq::BenchScentWindGPU(const Terrain &terrain, size_t particles) {
+    constexpr int FRAMES = 60;
+    constexpr float DT = 1.0f / 60.0f;
+    GLShader update_shader(Loader::readFromRelative("shader/scent/update_vertex.glsl"),
+                           Loader::readFromRelative("shader/scent/update_frag.glsl"),
+                           {"PositionAge", "Velocity", "Sprite", "Color"});
+    /* a short lifetime, so every particle is born before the timing starts,
+       the track on the ground so particles stay inside the boundary layer */
+    ScentGPU cloud(update_shader, 1.0f, 0.02f);
+    const glm::vec3 origin(0.0f, terrain.heightField().heightAt(0.0f, 0.0f), 0.0f);
+    cloud.addSource(origin, glm::vec3(1.0f, 0.0f, 0.0f), 100, particles);
+    cloud.initGL();
+    WindField open_air(16.0f, 1.0f), over_terrain(16.0f, 1.0f);
+    open_air.mean_ = over_terrain.mean_ = glm::vec3(1.0f, 0.0f, 0.5f);
+    over_terrain.setTerrain(&terrain);
+    GLTimer still_timer, open_timer, terrain_timer;
+    still_timer.initGL();
+    open_timer.initGL();
+    terrain_timer.initGL();
+
+    for (int frame = 0; frame < FRAMES; ++frame)
+        cloud.update(DT);
+    auto timed = [&](GLTimer &timer, const WindField *wind) {
+        cloud.setWind(wind);
+        timer.begin();
+        cloud.update(DT);
+        timer.end();
+    };
+    for (int frame = 0; frame < FRAMES + GLTimer::LATENCY; ++frame) {
+        timed(still_timer, nullptr);
+        timed(open_timer, &open_air);
+        timed(terrain_timer, &over_terrain);
+    }
+    glFinish();
+    LOG(INFO) << "Scent wind GPU: " << particles << " particles, still air " << still_timer.average()
+              << " ms, wind field " << open_timer.average() << " ms, following terrain "
+              << terrain_timer.average() << " ms, " << particles / terrain_timer.average() << " particles/ms";
+
+    still_timer.finishGL();
+    open_timer.finishGL();
+    terrain_timer.finishGL();
+    cloud.finishGL();
+}
+
+/* animals wander a 400 x 400 square for ten minutes at 10 Hz */
+void litewq::BenchTrackQueries(size_t animals) {
+    constexpr float DURATION = 600.0f, DT = 0.1f, HALF_SIZE = 200.0f;
+    constexpr int QUERIES = 10000, FRUSTA = 100;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::normal_distribution<float> turn(0.0f, 1.0f);
+    std::vector<glm::vec3> positions(animals);
+    std::vector<float> headings(animals);
+    for (size_t i = 0; i < animals; ++i) {
+        positions[i] = glm::vec3(uniform(rng), 0.0f, uniform(rng)) * HALF_SIZE;
+        headings[i] = uniform(rng) * glm::pi<float>();
+    }
+
+    TrackLog tracks;
+    /* every sample ever appended, the unindexed baseline */
+    std::vector<TrackLog::Sample> all;
+    high_resolution_clock::time_point t0 = high_resolution_clock::now();
+    float now = 0.0f;
+    for (int step = 0; now < DURATION; ++step, now += DT) {
+        for (size_t i = 0; i < animals; ++i) {
+            headings[i] += turn(rng) * std::sqrt(DT);
+            positions[i] += 1.5f * DT * glm::vec3(std::cos(headings[i]), 0.0f, std::sin(headings[i]));
+            positions[i] = glm::clamp(positions[i], -HALF_SIZE, HALF_SIZE);
+            if (tracks.append(uint16_t(i), uint8_t(i % 3), positions[i], now))
+                all.push_back({positions[i], now, uint16_t(i), uint8_t(i % 3), 0});
+        }
+        if (step % 10 == 0)
+            tracks.update(now);
+    }
+    double record = duration<double, std::milli>(high_resolution_clock::now() - t0).count();
+
+    /* what an animal looks for: a fresh track of its kind close by */
+    const float radius = 8.0f, max_age = 60.0f;
+    std::vector<glm::vec3> queries(QUERIES);
+    for (glm::vec3 &query : queries)
+        query = glm::vec3(uniform(rng), 0.0f, uniform(rng)) * HALF_SIZE;
+    TrackLog::Sample sample;
+    size_t found = 0;
+    t0 = high_resolution_clock::now();
+    for (const glm::vec3 &query : queries)
+        found += tracks.nearest(query, radius, now, max_age, 1, &sample);
+    double indexed = duration<double, std::micro>(high_resolution_clock::now() - t0).count() / QUERIES;
+    t0 = high_resolution_clock::now();
+    size_t brute_found = 0;
+    for (int q = 0; q < QUERIES / 10; ++q) {
+        float best = radius * radius;
+        for (const TrackLog::Sample &s : all) {
+            glm::vec2 d(s.position.x - queries[q].x, s.position.z - queries[q].z);
+            if (s.species == 1 && s.time >= now - max_age && glm::dot(d, d) < best)
+                best = glm::dot(d, d);
+        }
+        brute_found += best < radius * radius;
+    }
+    double brute = duration<double, std::micro>(high_resolution_clock::now() - t0).count() / (QUERIES / 10);
+
+    /* a walker's view over the whole track history */
+    std::vector<TrackLog::Sample> markers;
+    size_t visible = 0;
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    t0 = high_resolution_clock::now();
+    for (int f = 0; f < FRUSTA; ++f) {
+        glm::vec3 eye = queries[f] + glm::vec3(0.0f, 2.0f, 0.0f);
+        glm::vec3 ahead = eye + glm::vec3(uniform(rng), -0.2f, uniform(rng));
+        markers.clear();
+        tracks.visible(Frustum(projection * glm::lookAt(eye, ahead, glm::vec3(0.0f, 1.0f, 0.0f))), now,
+                       tracks.config_.max_age, &markers);
+        visible += markers.size();
+    }
+    double view = duration<double, std::micro>(high_resolution_clock::now() - t0).count() / FRUSTA;
+
+    LOG(INFO) << "Track log: " << animals << " animals, " << all.size() << " samples recorded, "
+              << tracks.size() << " kept in " << tracks.cells() << " cells, " << record << " ms to record";
+    LOG(INFO) << "Track log: nearest " << indexed << " us (" << 100.0 * found / QUERIES << "% found), brute force "
+              << brute << " us (" << 1000.0 * brute_found / QUERIES << "% found), visible " << view << " us ("
+              << visible / FRUSTA << " markers)";
+}
+
+/* the node per allocation layout LinearBVHNode replaced, rebuilt from the
+   same tree so only the layout and traversal differ */
+struct PointerBVHNode {
+    Bounds3 bound;
+    PointerBVHNode *left = nullptr;
+    PointerBVHNode *right = nullptr;
+};
+
+static PointerBVHNode *toPointerTree(const BVHUtils &bvh, uint32_t index) {
+    const LinearBVHNode &linear = bvh.nodes[index];
+    PointerBVHNode *node = new PointerBVHNode;
+    node->bound = linear.bound();
+    if (linear.nShapes == 0) {
+        node->left = toPointerTree(bvh, index + 1);
+        node->right = toPointerTree(bvh, linear.secondChildOffset);
+    }
+    return node;
+}
+
+static void deletePointerTree(PointerBVHNode *node) {
+    if (node->left) {
+        deletePointerTree(node->left);
+        deletePointerTree(node->right);
+    }
+    delete node;
+}
+
+static bool intersectPointerTree(const PointerBVHNode *node, const Bounds3 &bbox) {
+    if (!Overlaps(node->bound, bbox))
+        return false;
+    if (node->left == nullptr && node->right == nullptr)
+        return true;
+    bool hit0 = intersectPointerTree(node->left, bbox);
+    bool hit1 = intersectPointerTree(node->right, bbox);
+    return hit0 || hit1;
+}
+
+void litewq::BenchBVHCollision(const char *name, TriMesh *mesh, size_t queries) {
+    high_resolution_clock::time_point t0 = high_resolution_clock::now();
+    if (!mesh->bvh)
+        mesh->buildBVH();
+    double build = duration<double, std::milli>(high_resolution_clock::now() - t0).count();
+    const BVHUtils &bvh = *mesh->bvh;
+    CHECK_EQ(bvh.maxShapeInNode, 1u) << "The pointer tree has one shape per leaf";
+
+    /* camera steps, as processInput tests them: half anywhere around the
+       mesh, half at its surface where bounds and triangles disagree */
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f), step(-0.05f, 0.05f);
+    std::uniform_int_distribution<size_t> shape(0, bvh.shapes.size() - 1);
+    const Bounds3 world = bvh.WorldBound();
+    const glm::vec3 size = world.Diagonal();
+    std::vector<Bounds3> boxes(queries);
+    for (size_t n = 0; n < queries; ++n) {
+        glm::vec3 p = n % 2 ? bvh.shapeBounds[shape(rng)].Centroid() + 0.4f * size * glm::vec3(step(rng), step(rng), step(rng))
+                            : world.pMin - 0.1f * size + 1.2f * size * glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        boxes[n] = Bounds3(p, p + glm::vec3(step(rng), step(rng), step(rng)));
+    }
+
+    /* before: bound overlaps only, pointer nodes */
+    PointerBVHNode *root = toPointerTree(bvh, 0);
+    t0 = high_resolution_clock::now();
+    size_t bound_hits = 0;
+    for (const Bounds3 &box : boxes)
+        bound_hits += intersectPointerTree(root, box);
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    size_t hits = 0;
+    for (const Bounds3 &box : boxes)
+        hits += bvh.intersect(box);
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    std::vector<Shape *> found;
+    size_t collected = 0, nonempty = 0;
+    for (const Bounds3 &box : boxes) {
+        found.clear();
+        size_t count = bvh.intersect(box, &found);
+        collected += count;
+        nonempty += count > 0;
+    }
+    high_resolution_clock::time_point t3 = high_resolution_clock::now();
+    deletePointerTree(root);
+    CHECK_LE(hits, bound_hits) << "Exact collision outside the bounds";
+    CHECK_EQ(hits, nonempty) << "Any hit and collect all disagree";
+
+    double bounds = duration<double>(t1 - t0).count(), any = duration<double>(t2 - t1).count(),
+           all = duration<double>(t3 - t2).count();
+    LOG(INFO) << "BVH collision (" << name << "): " << bvh.shapes.size() << " triangles, " << bvh.nodes.size()
+              << " nodes built in " << build << " ms, bounds only (before) " << queries / bounds * 1e-6
+              << " Mqueries/s " << 100.0 * bound_hits / queries << "% hit, exact any hit " << queries / any * 1e-6
+              << " Mqueries/s " << 100.0 * hits / queries << "% hit, exact collect all " << queries / all * 1e-6
+              << " Mqueries/s " << double(collected) / queries << " triangles per query, "
+              << (bound_hits ? 100.0 * (bound_hits - hits) / bound_hits : 0.0) << "% of bound hits were false positives";
+}
+
+void litewq::BenchBVHRays(const char *name, TriMesh *mesh, size_t rays) {
+    if (!mesh->bvh)
+        mesh->buildBVH();
+    const BVHUtils &bvh = *mesh->bvh;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const Bounds3 world = bvh.WorldBound();
+    const glm::vec3 size = world.Diagonal();
+    auto inside = [&]() { return world.pMin + size * glm::vec3(uniform(rng), uniform(rng), uniform(rng)); };
+
+    std::vector<Ray> queries(rays);
+    std::vector<RayHit> hits(rays);
+    std::vector<uint8_t> occluded(rays);
+    auto run = [&](const char *kind) {
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        size_t found = 0;
+        for (size_t n = 0; n < rays; ++n)
+            found += bvh.intersect(queries[n], &hits[n]);
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        bvh.intersect(queries.data(), hits.data(), rays);
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        size_t blocked = 0;
+        for (size_t n = 0; n < rays; ++n)
+            blocked += bvh.intersectP(queries[n]);
+        high_resolution_clock::time_point t3 = high_resolution_clock::now();
+        size_t blocked_batched = bvh.intersectP(queries.data(), occluded.data(), rays);
+        high_resolution_clock::time_point t4 = high_resolution_clock::now();
+        CHECK_EQ(found, blocked) << "Closest and any hit disagree";
+        CHECK_EQ(blocked, blocked_batched) << "Batched any hit disagrees";
+
+        /* the closest hit of a few rays against every triangle */
+        for (size_t n = 0; n < std::min<size_t>(rays, 1000); ++n) {
+            Ray ray = queries[n];
+            RayHit best, hit;
+            for (Shape *shape : bvh.shapes)
+                if (shape->Intersect(ray, &hit)) {
+                    best = hit;
+                    ray.tMax = hit.t;
+                }
+            CHECK_EQ(best.t, hits[n].t) << "BVH and brute force closest hits differ";
+        }
+
+        double one = duration<double>(t1 - t0).count(), many = duration<double>(t2 - t1).count(),
+               any = duration<double>(t3 - t2).count(), any_many = duration<double>(t4 - t3).count();
+        LOG(INFO) << "BVH rays (" << name << ", " << kind << "): " << rays << " rays, " << 100.0 * found / rays
+                  << "% hit, closest " << rays / one * 1e-6 << " Mrays/s one thread, " << rays / many * 1e-6
+                  << " Mrays/s batched, any " << rays / any * 1e-6 << " Mrays/s one thread, "
+                  << rays / any_many * 1e-6 << " Mrays/s batched";
+    };
+
+    /* picking, from around the mesh through a point of its bound */
+    for (size_t n = 0; n < rays; ++n) {
+        glm::vec3 eye = world.Centroid() + glm::length(size) * glm::normalize(inside() - world.Centroid());
+        queries[n] = Ray(eye, glm::normalize(inside() - eye));
+    }
+    run("picking");
+
+    /* snapping down onto the mesh from above its bound */
+    for (size_t n = 0; n < rays; ++n) {
+        glm::vec3 p = inside();
+        p.y = world.pMax.y + 0.1f * size.y;
+        queries[n] = Ray(p, glm::vec3(0.0f, -1.0f, 0.0f));
+    }
+    run("snap");
+
+    /* line of sight between two points of the bound, t in (0, 1] */
+    for (size_t n = 0; n < rays; ++n) {
+        glm::vec3 from = inside();
+        queries[n] = Ray(from, inside() - from, 1.0f);
+    }
+    run("line of sight");
+}
@@ -9,6 +9,32 @@ void Scene::render() const {
     }
 }
 
+static bool matches(const TriMesh *object, Scene::Motion motion) {
+    return motion == Scene::Motion::ANY || object->dynamic == (motion == Scene::Motion::DYNAMIC);
+}
+
+void Scene::render(const Frustum &frustum, Motion motion) const {
+    for (auto *object : objects) {
+        if (matches(object, motion) && frustum.intersect(object->WorldBound()))
+            object->render();
+    }
+}
+
+void Scene::renderDepth(const Frustum &frustum, Motion motion) const {
+    for (auto *object : objects) {
+        if (matches(object, motion) && frustum.intersect(object->WorldBound()))
+            object->renderDepth();
+    }
+}
+
+bool Scene::visible(const Frustum &frustum, Motion motion) const {
+    for (auto *object : objects) {
+        if (matches(object, motion) && frustum.intersect(object->WorldBound()))
+            return true;
+    }
+    return false;
+}
+
 bool Scene::collision(const litewq::Bounds3 &hitbox) {
     bool hasCollision = false;
     for (auto *object : objects) {
@@ -16,4 +42,17 @@ bool Scene::collision(const litewq::Bounds3 &hitbox) {
             hasCollision |= object->bvh->intersect(hitbox);
     }
     return hasCollision;
-}
\ No newline at end of file
+}
+
+bool Scene::intersect(const Ray &ray, RayHit *hit) const {
+    /* every hit lowers tMax, later objects only count when nearer */
+    Ray nearest = ray;
+    bool found = false;
+    for (auto *object : objects) {
+        if (object->bvh && object->bvh->intersect(nearest, hit)) {
+            nearest.tMax = hit->t;
+            found = true;
+        }
+    }
+    return found;
+}
@@ -1,13 +1,24 @@
 #include "litewq/mesh/TriMesh.h"
 #include "litewq/utils/logging.h"
 #include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLTimer.h"
 #include "litewq/camera/camera.h"
 #include "litewq/utils/Loader.h"
-#include "litewq/scent/scent.h"
+#include "litewq/scent/ScentField.h"
+#include "litewq/scent/ScentGPU.h"
+#include "litewq/scent/ScentManager.h"
+#include "litewq/scent/ScentOIT.h"
+#include "litewq/scent/TrackLog.h"
+#include "litewq/scent/WindField.h"
 #include "litewq/mesh/SkyBoxMesh.h"
 #include "litewq/mesh/SkyBoxTexture.h"
 #include "litewq/camera/Scene.h"
 #include "litewq/math/BoundingBox.h"
+#include "litewq/math/Frustum.h"
+#include "litewq/terrain/Terrain.h"
+#include "litewq/terrain/TerrainPager.h"
+#include "litewq/shadow/CascadedShadowMap.h"
+#include "litewq/bench/Bench.h"
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -16,21 +27,33 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
+#include "glm/gtc/constants.hpp"
 
 #include <iostream>
 #include <cmath>
+#include <filesystem>
+#include <memory>
 #include <random>
 
 using namespace litewq;
 
 const int SCR_WIDTH = 800;
 const int SCR_HEIGHT = 600;
+const float EYE_HEIGHT = 0.5f;
+const float Z_NEAR = 0.1f;
+const float Z_FAR = 100.0f;
+/* particles shared by the scent sources, and of the GPU simulated scent cloud */
+const size_t SCENT_PARTICLES = 20000;
+const size_t SCENT_CLOUD_PARTICLES = 200000;
+const int TRACK_ANIMALS = 24;
 
 int window_width = SCR_WIDTH;
 int window_height = SCR_HEIGHT;
 
 int current_width = SCR_WIDTH;
 int current_height = SCR_HEIGHT;
+/* the scent cloud is drawn at 1 / scent_resolution of the screen, R cycles 1, 2, 4 */
+int scent_resolution = 1;
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
@@ -52,6 +75,8 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 			glfwSetWindowShouldClose(window, true);
 		if (key == GLFW_KEY_F)
 			camera.toggle_fly_mode();
+		if (key == GLFW_KEY_R)
+			scent_resolution = scent_resolution == 4 ? 1 : scent_resolution * 2;
 		if (key == GLFW_KEY_F11 || (key == GLFW_KEY_ENTER && mods == GLFW_MOD_ALT))
 		{
 			static bool fullscreen = false;
@@ -182,64 +207,71 @@ unsigned int loadTexture(const char *path)
 	return textureID;
 }
 
-int width, height, nrChannels;
-uint8_t *renderHeightMap(const std::string &filename, float scale) {
-    static GLuint VAO, VBO, EBO;
-    static uint8_t *data = nullptr;
-    if (VAO == 0) {
-        data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-        if (data == nullptr) {
-            LOG(FATAL) << "Failed to load texture: " << filename;
-        }
-        std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
-        for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-                Vertex vert;
-                vert.position_ = glm::vec3(
-                        -height / 2.0f + i,
-                        scale * data[(i * width + j) * nrChannels] - 20.5,
-                        -width / 2.0f + j);
-                vert.normal_ = glm::vec3(0.0f, 1.0f, 0.0f);
-                vert.texture_coords_ = glm::vec2(
-                        (i % 8) / 8.0f,
-                        (j % 8) / 8.0f);
-                vertices.push_back(vert);
-            }
-        }
-        for (int i = 0; i < height - 1; i++)
-            for (int j = 0; j < width; j++)
-                for (int k = 0; k < 2; k++)
-                    indices.push_back((i + k) * width + j);
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-        // position
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) 0);
-        // normal
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, normal_));
-        // texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, texture_coords_));
-        glBindVertexArray(0);
-    } else {
-        glBindVertexArray(VAO);
-        for (int i = 0; i < height - 1; i++)
-            glDrawElements(GL_TRIANGLE_STRIP, 2 * width, GL_UNSIGNED_INT, (void *) (i * 2 * width * sizeof(unsigned int)));
-        glBindVertexArray(0);
-    }
-    return data;
+/* The scent track near the origin, and tracks, carcasses, dens and scent
+   posts scattered over the world around it. */
+static void populateScents(ScentManager *scents, std::default_random_engine &generator)
+{
+	std::uniform_real_distribution<float> nearby(-50.0f, 50.0f), world(-400.0f, 400.0f);
+	std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+	std::uniform_int_distribution<int> track_length(10, 80);
+
+	glm::vec3 from(nearby(generator), 0.1f, nearby(generator)), to(nearby(generator), 0.1f, nearby(generator));
+	scents->addTrack(from, to - from, std::max(int(glm::distance(from, to)), 1), 1.0f, 1000);
+	for (int i = 0; i < 400; i++)
+	{
+		float a = angle(generator);
+		scents->addTrack(glm::vec3(world(generator), 0.1f, world(generator)),
+			glm::vec3(std::cos(a), 0.0f, std::sin(a)), track_length(generator));
+	}
+	for (int i = 0; i < 20; i++)
+		scents->addPoint(ScentManager::SourceKind::CARCASS, glm::vec3(world(generator), 0.1f, world(generator)), 4.0f);
+	for (int i = 0; i < 40; i++)
+		scents->addPoint(ScentManager::SourceKind::DEN, glm::vec3(world(generator), 0.1f, world(generator)), 2.0f);
+	for (int i = 0; i < 100; i++)
+		scents->addPoint(ScentManager::SourceKind::POST, glm::vec3(world(generator), 0.1f, world(generator)), 1.0f);
+}
+
+/* an animal walking around and leaving tracks */
+struct Wanderer
+{
+	glm::vec3 position;
+	float heading;
+	float speed;
+	uint8_t species;
+};
+
+/* Random walk on the terrain, every animal appends to the track log as it goes. */
+static void wanderAnimals(std::vector<Wanderer> *animals, TrackLog *tracks, const Terrain &terrain,
+	std::default_random_engine &generator, float time, float dt)
+{
+	std::normal_distribution<float> turn(0.0f, 1.0f);
+	for (size_t i = 0; i < animals->size(); i++)
+	{
+		Wanderer &animal = (*animals)[i];
+		animal.heading += turn(generator) * std::sqrt(dt);
+		animal.position += glm::vec3(std::cos(animal.heading), 0.0f, std::sin(animal.heading)) * animal.speed * dt;
+		animal.position.y = terrain.heightAt(animal.position.x, animal.position.z);
+		tracks->append(uint16_t(i), animal.species, animal.position, time);
+	}
+}
+
+#ifdef LITEWQ_GLES
+/* glad reads "OpenGL ES 3.0" as GL 3.0 and skips these, which ES 3.0 has in core */
+static void loadGLESEntryPoints()
+{
+	glad_glDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC)glfwGetProcAddress("glDrawArraysInstanced");
+	glad_glVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)glfwGetProcAddress("glVertexAttribDivisor");
+	glad_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)glfwGetProcAddress("glTexStorage2D");
 }
+#endif
 
 int main(int argc, char *argv[])
 {
+	// CPU benchmarks run first, the GL ones once there is a context
+	bool bench = argc > 1 && std::string(argv[1]) == "--bench";
+	if (bench)
+		RunBenchmarks();
+
 	// Initialize glfw
 	if (!glfwInit())
 	{
@@ -247,6 +279,12 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+#ifdef LITEWQ_GLES
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+#endif
+
 	// Create window
 	GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", nullptr, nullptr);
 	if (window == nullptr)
@@ -270,6 +308,15 @@ int main(int argc, char *argv[])
 		LOG(FATAL) << "Failed to initialize glad" << std::endl;
 		return -1;
 	}
+#ifdef LITEWQ_GLES
+	loadGLESEntryPoints();
+#endif
+	if (bench)
+	{
+		RunGLBenchmarks();
+		glfwTerminate();
+		return 0;
+	}
 
 	// Create shader
 	GLShader shader(
@@ -278,8 +325,25 @@ int main(int argc, char *argv[])
 	);
 
     GLShader scent_shader(
-        Loader::readFromRelative("shader/simple/vertex.glsl"),
-        Loader::readFromRelative("shader/simple/scent_frag.glsl")
+        Loader::readFromRelative("shader/scent/vertex.glsl"),
+        Loader::readFromRelative("shader/scent/frag.glsl")
+    );
+    GLShader scent_oit_shader(
+        Loader::readFromRelative("shader/scent/vertex.glsl"),
+        Loader::readFromRelative("shader/scent/oit_frag.glsl")
+    );
+    GLShader scent_composite_shader(
+        Loader::readFromRelative("shader/scent/composite_vertex.glsl"),
+        Loader::readFromRelative("shader/scent/composite_frag.glsl")
+    );
+    GLShader track_shader(
+        Loader::readFromRelative("shader/scent/track_vertex.glsl"),
+        Loader::readFromRelative("shader/scent/frag.glsl")
+    );
+    GLShader scent_update_shader(
+        Loader::readFromRelative("shader/scent/update_vertex.glsl"),
+        Loader::readFromRelative("shader/scent/update_frag.glsl"),
+        {"PositionAge", "Velocity", "Sprite", "Color"}
     );
 
 	GLShader phong(
@@ -302,6 +366,16 @@ int main(int argc, char *argv[])
         Loader::readFromRelative("shader/shadow/depth_frag.glsl")
     );
 
+    GLShader terrain_shader(
+        Loader::readFromRelative("shader/terrain/vertex.glsl"),
+        Loader::readFromRelative("shader/shadow/shadowmap_frag.glsl")
+    );
+
+    GLShader terrain_depth(
+        Loader::readFromRelative("shader/terrain/vertex.glsl"),
+        Loader::readFromRelative("shader/shadow/depth_frag.glsl")
+    );
+
     GLShader debug_depth(
         Loader::readFromRelative("shader/shadow/depth_debug_vertex.glsl"),
         Loader::readFromRelative("shader/shadow/depth_debug_frag.glsl")
@@ -328,8 +402,23 @@ int main(int argc, char *argv[])
 
 	// Create scent
 	std::default_random_engine generator(time(NULL));
-    Scent scent(generator, scent_shader, 0.1f);
-    scent.initGL();
+    /* scent concentration over the area the tracks are placed in */
+    ScentField scent_field(glm::vec3(-64.0f, 0.0f, -64.0f), 1.0f, 128, 128, 4, 0.5f);
+    ScentManager scents(scent_shader, SCENT_PARTICLES, generator());
+    populateScents(&scents, generator);
+    scents.setField(&scent_field);
+    scents.initGL();
+    /* a dense cloud over the same track, simulated on the GPU */
+    ScentGPU scent_cloud(scent_update_shader, 60.0f, 0.02f);
+    scent_cloud.intensity_ = 0.15f;
+    scent_cloud.addSource(scents.source(0).position, scents.source(0).direction, scents.source(0).length,
+                          SCENT_CLOUD_PARTICLES);
+    scent_cloud.initGL();
+    /* the cloud is too large to sort, it is blended order independently */
+    ScentOIT scent_oit(scent_composite_shader);
+    scent_oit.initGL(current_width, current_height);
+    scent_oit.z_near_ = Z_NEAR;
+    scent_oit.z_far_ = Z_FAR;
 
     auto wolf =
             TriMesh::from_obj(Loader::getAssetPath("model/wolf/wolf.obj"));
@@ -337,13 +426,14 @@ int main(int argc, char *argv[])
     wolf_raw->initGL();
     wolf_raw->updateModel(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.5f)));
     wolf_raw->buildBVH();
+    wolf_raw->dynamic = true;
 
     auto tree =
             TriMesh::from_obj(Loader::getAssetPath("model/tree/Tree1.obj"));
     auto tree_raw = static_cast<TriMesh *>(tree.get());
     tree_raw->initGL();
     tree_raw->updateModel(glm::scale(glm::mat4(1.0f), glm::vec3(.5f, .5f, .5f)));
-    // tree_raw->buildBVH();
+    tree_raw->buildBVH();
 
     /* Skybox forest */
     auto skybox = litewq::SkyBoxMesh::build();
@@ -369,35 +459,53 @@ int main(int argc, char *argv[])
     scene.addObject(tree_raw);
     scene.addObject(wolf_raw);
 
-    /* Shadow mapping, depth frame buffer and stored in texture. */
-    unsigned int DepthMapFBO, DepthMap;
-    constexpr unsigned int SHADOW_WIDTH = 2048, SHADOW_HEIGHT = 2048;
-    glGenFramebuffers(1, &DepthMapFBO);
-
-    glGenTextures(1, &DepthMap);
-    glBindTexture(GL_TEXTURE_2D, DepthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-                 SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    /* if you choose repeat wrapping method, shadow will repeat outside shadow port*/
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-    glm::vec4 BorderColor = glm::vec4(1.f, 1.f, 1.f, 1.f);
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, glm::value_ptr(BorderColor));
-    // attach depth texture as FBO's depth buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, DepthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, DepthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    uint8_t *data = renderHeightMap("assets/tex/iceland_heightmap.png", 0.2f);
+    /* Cascaded shadow maps, ShadowConfig::mobile() for weaker GPUs */
+    CascadedShadowMap shadow_map(ShadowConfig::desktop());
+    shadow_map.initGL();
+    constexpr unsigned int SHADOW_TEX_UNIT = 1;
+    GLTimer shadow_timer;
+    shadow_timer.initGL();
+    int shadow_refreshes = 0;
+
+    // stream heights around the camera when the map was tiled (litewq_tiler),
+    // the whole heightmap is only loaded without tiles
+    std::string heightmap = Loader::getAssetPath("tex/iceland_heightmap.png");
+    std::unique_ptr<TerrainPager> pager;
+    if (std::filesystem::exists(heightmap + ".tiles")) {
+        pager = std::make_unique<TerrainPager>(heightmap + ".tiles", 0.2f, -20.5f, 64 << 20, 512.0f);
+        pager->initGL();
+    }
+    float pager_log_time = 0.0f;
+    Terrain terrain = pager ? Terrain(pager.get()) : Terrain(heightmap, 0.2f, -20.5f);
+    terrain.initGL();
+
+    /* scent drifts with gusts that follow the ground, which needs the
+       whole heightfield; over paged terrain it blows in open air */
+    WindField cloud_wind(8.0f, 0.5f);
+    if (!terrain.paged()) {
+        scents.wind_field_.setTerrain(&terrain);
+        cloud_wind.setTerrain(&terrain);
+    }
+    scents.start();
+    scent_cloud.setWind(&cloud_wind);
+
+    /* animals around the start and the trails they leave */
+    TrackLog tracks;
+    tracks.initGL();
+    std::vector<Wanderer> animals(TRACK_ANIMALS);
+    {
+        std::uniform_real_distribution<float> nearby(-30.0f, 30.0f), angle(0.0f, glm::two_pi<float>()),
+            speed(0.8f, 2.0f);
+        for (size_t i = 0; i < animals.size(); ++i)
+            animals[i] = {glm::vec3(nearby(generator), 0.0f, nearby(generator)), angle(generator),
+                          speed(generator), uint8_t(i % 3)};
+    }
 
     // configure shader
-    shadow.Bind();
-    shadow.updateUniformInt("shadowMap", 1);
+    terrain_shader.Bind();
+    terrain_shader.updateUniformInt("material.Kd", 0);
+    terrain_shader.updateUniformFloat3("material.Ks", glm::vec3(0.1f, 0.1f, 0.1f));
+    terrain_shader.updateUniformFloat("material.highlight_decay", 16.0f);
 
 
     // Render loop
@@ -415,21 +523,18 @@ int main(int argc, char *argv[])
 
         // Update height & up vector
         glm::vec3 cameraPos = camera.get_position();
-        float fx = cameraPos.x + height / 2.0f;
-        int x = floor(fx);
-        float fy = cameraPos.z + width / 2.0f;
-        int y = floor(fy);
-        float height1 = 0.2f * data[(x * width + y) * nrChannels] - 32;
-        float height2 = 0.2f * data[((x + 1) * width + y) * nrChannels] - 32;
-        float height3 = 0.2f * data[(x * width + y + 1) * nrChannels] - 32;
-        float height4 = 0.2f * data[((x + 1) * width + y + 1) * nrChannels] - 32;
-        // Bilinear interpolation
-        float height = height1 * (x + 1 - fx) * (y + 1 - fy) +
-                       height2 * (fx - x) * (y + 1 - fy) +
-                       height3 * (x + 1 - fx) * (fy - y) +
-                       height4 * (fx - x) * (fy - y);
-
-        camera.sety(height + 12.0f);
+        if (pager) {
+            pager->update(cameraPos);
+            pager->upload();
+            if (currentFrame - pager_log_time > 10.0f) {
+                TerrainPager::Stats stats = pager->stats();
+                LOG(INFO) << "Terrain pager: hit rate " << stats.hitRate() << ", " << stats.loads
+                          << " loads, " << stats.evictions << " evictions, " << stats.stalls
+                          << " stalls (" << stats.stall_time * 1000.0 << " ms)";
+                pager_log_time = currentFrame;
+            }
+        }
+        camera.sety(terrain.heightAt(cameraPos.x, cameraPos.z) + EYE_HEIGHT);
 
         // Render
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -439,15 +544,9 @@ int main(int argc, char *argv[])
         float light_x = cos(currentFrame / 5) * 3;
         float light_z = sin(currentFrame / 5) * 3;
         glm::vec3 light_pos = glm::vec3(light_x, 4.f, light_z);
-        glm::mat4 light_projection = glm::ortho(-10.f, 10.f, -10.f, 10.f, 1.0f, 7.5f);
-        glm::mat4 light_view = glm::lookAt(light_pos, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
-        glm::mat4 world2light = light_projection * light_view;
-
-        depth_shader.Bind();
-        depth_shader.updateUniformMat4("lightSpaceMatrix", world2light);
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, DepthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
+        glm::mat4 view = camera.get_view_matrix();
+        glm::mat4 projection = glm::perspective(camera.get_zoom(), (float)window_width / (float)window_height, Z_NEAR, Z_FAR);
+        shadow_map.update(view, projection, Z_NEAR, Z_FAR, light_pos);
 
         glm::mat4 model = glm::mat4(1.0f);
 
@@ -462,8 +561,37 @@ int main(int argc, char *argv[])
 //
 //        glm::mat4 wolf_model2world = glm::lookAt(wolf_pos, wolf_pos + head_dir, ground_up_vec);
 
-        scene.render();
-        renderHeightMap("", 1.0f);
+        /* each cascade only draws the casters inside its light frustum,
+         * static ones only when its cached layer is refreshed */
+        shadow_timer.begin();
+        for (int cascade = 0; cascade < shadow_map.cascades(); ++cascade) {
+            const glm::mat4 &world2light = shadow_map.lightMatrix(cascade);
+            const Frustum &light_frustum = shadow_map.frustum(cascade);
+            if (shadow_map.refreshing(cascade)) {
+                shadow_map.bindStatic(cascade);
+                depth_shader.Bind();
+                depth_shader.updateUniformMat4("lightSpaceMatrix", world2light);
+                scene.renderDepth(light_frustum, Scene::Motion::STATIC);
+                terrain.select(cameraPos, light_frustum);
+                terrain_depth.Bind();
+                terrain_depth.updateUniformMat4("projection", world2light);
+                terrain_depth.updateUniformMat4("view", glm::mat4(1.0f));
+                terrain.render(&terrain_depth);
+            }
+            if (shadow_map.bindDynamic(cascade, scene.visible(light_frustum, Scene::Motion::DYNAMIC))) {
+                depth_shader.Bind();
+                depth_shader.updateUniformMat4("lightSpaceMatrix", world2light);
+                scene.renderDepth(light_frustum, Scene::Motion::DYNAMIC);
+            }
+        }
+        shadow_timer.end();
+        shadow_refreshes += shadow_map.refreshed();
+        if (shadow_timer.samples() >= 300) {
+            LOG(INFO) << "Shadow pass: " << shadow_timer.average() << " ms GPU, "
+                      << shadow_refreshes / 300.0f << " cached layer refreshes per frame";
+            shadow_timer.reset();
+            shadow_refreshes = 0;
+        }
 
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -472,25 +600,36 @@ int main(int argc, char *argv[])
 
 
         // Draw scent
-        glm::mat4 view = camera.get_view_matrix();
-        glm::mat4 projection = glm::perspective(camera.get_zoom(), (float)window_width / (float)window_height, 0.1f, 100.0f);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, DepthMap);
         shadow.Bind();
+        shadow_map.bind(&shadow, SHADOW_TEX_UNIT);
         shadow.updateUniformFloat3("light.pos", light_pos);
         shadow.updateUniformFloat3("light.Ia", glm::vec3(0.5f, 0.5f, 0.5f));
         shadow.updateUniformFloat3("light.Id", glm::vec3(1.0f, 1.0f, 1.0f));
         shadow.updateUniformFloat3("light.Is", glm::vec3(0.2f, 0.2f, 0.2f));
-        shadow.updateUniformMat4("lightSpaceMatrix", world2light);
         shadow.updateUniformFloat3("view_pos", camera.get_position());
         shadow.updateUniformMat4("view", view);
         shadow.updateUniformMat4("projection", projection);
 
 
         scene.render();
+
+        terrain.select(cameraPos, Frustum(projection * view));
+        terrain_shader.Bind();
+        terrain_shader.updateUniformFloat3("light.pos", light_pos);
+        terrain_shader.updateUniformFloat3("light.Ia", glm::vec3(0.5f, 0.5f, 0.5f));
+        terrain_shader.updateUniformFloat3("light.Id", glm::vec3(1.0f, 1.0f, 1.0f));
+        terrain_shader.updateUniformFloat3("light.Is", glm::vec3(0.2f, 0.2f, 0.2f));
+        shadow_map.bind(&terrain_shader, SHADOW_TEX_UNIT);
+        terrain_shader.updateUniformFloat3("view_pos", camera.get_position());
+        terrain_shader.updateUniformMat4("view", view);
+        terrain_shader.updateUniformMat4("projection", projection);
+        glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texGrass);
-        renderHeightMap("", 1.0f);
+        terrain.render(&terrain_shader);
+
+        wanderAnimals(&animals, &tracks, terrain, generator, currentFrame, deltaTime);
+        tracks.update(currentFrame);
+        tracks.render(track_shader, Frustum(projection * view), currentFrame, view, projection);
 
         /* skybox */
         skybox_shader.Bind();
@@ -499,10 +638,15 @@ int main(int argc, char *argv[])
         skybox_tex.BindTexture();
         skybox->render();
 
-        scent_shader.Bind();
-        scent_shader.updateUniformMat4("view", view);
-        scent_shader.updateUniformMat4("projection", projection);
-        scent.render(cameraPos, view, projection, glm::vec4(0, 0, current_width, current_height));
+        scents.render(cameraPos, view, projection);
+        cloud_wind.mean_ = 0.5f * glm::vec3(std::cos(currentFrame * 0.1f), 0.0f, std::sin(currentFrame * 0.1f));
+        cloud_wind.advance(deltaTime);
+        scent_cloud.update(deltaTime);
+        scent_oit.resize(current_width, current_height);
+        scent_oit.setResolution(scent_resolution);
+        scent_oit.begin(0);
+        scent_cloud.render(scent_oit_shader, view, projection);
+        scent_oit.end(0);
 
         /* render depth */
 //        debug_depth.Bind();
@@ -523,6 +667,16 @@ int main(int argc, char *argv[])
 	glDeleteBuffers(2, VBOs.data());
 	glDeleteTextures(1, &texContainer);
 	glDeleteTextures(1, &texGrass);
+	terrain.finishGL();
+	shadow_map.finishGL();
+	scents.stop();
+	scents.finishGL();
+	scent_cloud.finishGL();
+	scent_oit.finishGL();
+	tracks.finishGL();
+	shadow_timer.finishGL();
+	if (pager)
+		pager->finishGL();
 	glfwTerminate();
 	return 0;
 }
@@ -4,126 +4,131 @@
 
 #include <chrono>
 #include <algorithm>
+#include <limits>
 
 using namespace litewq;
 using namespace std::chrono;
 
-static BVHNode *BuildBVH(std::vector<Shape *> shapes,
-                         int begin, int end)
+/* SAH cost of visiting a node, relative to testing one shape */
+static constexpr float TRAVERSAL_COST = 0.125f;
+static constexpr int N_BUCKETS = 12;
+/* subtrees with fewer shapes are built by the task that reached them */
+static constexpr int PARALLEL_SHAPES = 4096;
+
+namespace {
+/* what the builder needs of a shape, computed once */
+struct BVHPrimitive {
+    Bounds3 bound;
+    glm::vec3 centroid;
+    uint32_t index;
+};
+} // end anonymous namespace
+
+static int bucket(const BVHPrimitive &primitive, const Bounds3 &centroidBounds, int dim) {
+    int b = int(N_BUCKETS * centroidBounds.Offset(primitive.centroid)[dim]);
+    return std::min(b, N_BUCKETS - 1);
+}
+
+/* Append the subtree over primitives [begin, end) to nodes in depth first
+ * order, with binned SAH splits; returns the index of its root. The
+ * primitives are partitioned in place, so leaves cover contiguous ranges. */
+static uint32_t BuildBVH(std::vector<BVHPrimitive> &primitives, int begin, int end, int depth,
+                         unsigned int maxShapeInNode, std::vector<LinearBVHNode> *nodes)
 {
     CHECK_LT(begin, end);
-    BVHNode *Node = new BVHNode;
+    CHECK_LT(depth, BVHUtils::MAX_DEPTH) << "BVH too deep for the traversal stack";
+    uint32_t index = nodes->size();
+    nodes->emplace_back();
 
-    Bounds3 NodeBound;
+    Bounds3 NodeBound, centroidBounds;
     for (int i = begin; i < end; ++i) {
-        NodeBound = Union(NodeBound, shapes[i]->WorldBound());
+        NodeBound = Union(NodeBound, primitives[i].bound);
+        centroidBounds = Union(centroidBounds, primitives[i].centroid);
     }
-    if (end - begin == 1) {
-        Node->bound = shapes[begin]->WorldBound();
-        Node->left = nullptr;
-        Node->right = nullptr;
-        return Node;
-    }
-    else if (end - begin == 2) {
-        Node->left = BuildBVH(shapes, begin, begin + 1);
-        Node->right = BuildBVH(shapes, begin + 1, end);
+    (*nodes)[index].pMin = NodeBound.pMin;
+    (*nodes)[index].pMax = NodeBound.pMax;
+    const int count = end - begin;
+    auto makeLeaf = [&]() {
+        (*nodes)[index].shapesOffset = begin;
+        (*nodes)[index].nShapes = count;
+        return index;
+    };
 
-        Node->bound = Union(Node->left->bound, Node->right->bound);
-        return Node;
+    int dim = centroidBounds.MaximumExtent();
+    int mid = begin + count / 2;
+    if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) {
+        /* all centroids in one spot, nothing to tell them apart */
+        if (count <= int(maxShapeInNode))
+            return makeLeaf();
     }
     else {
-        Bounds3 centroidBounds;
-        for (int i = begin; i < end; ++i) {
-            centroidBounds =
-                    Union(centroidBounds, shapes[i]->WorldBound().Centroid());
-        }
         /* Estimate SAH */
-        constexpr int nBuckets = 12;
         struct BucketInfo {
             int count = 0;
             Bounds3 bound;
         };
-        BucketInfo buckets[nBuckets];
-        int dim = centroidBounds.MaximumExtent();
-        float minCost = INFINITY;
-        int minCostSplit = 0;
+        BucketInfo buckets[N_BUCKETS];
         for (int i = begin; i < end; ++i) {
-            Bounds3 shape_bound = shapes[i]->WorldBound();
-            int b = nBuckets * centroidBounds.Offset(shape_bound.Centroid())[dim];
-            if (b == nBuckets)
-                b = nBuckets - 1;
-            CHECK_GE(b, 0);
-            CHECK_LT(b, nBuckets);
+            int b = bucket(primitives[i], centroidBounds, dim);
             buckets[b].count++;
-            buckets[b].bound = Union(buckets[b].bound, shape_bound);
+            buckets[b].bound = Union(buckets[b].bound, primitives[i].bound);
         }
-        /* enumerate split point */
-        for (int i = 0; i < nBuckets - 1; ++i) {
-            Bounds3 b0, b1;
-            int count0 = 0, count1 = 0;
-            for (int j = 0; j <= i; ++j) {
-                b0 = Union(b0, buckets[j].bound);
-                count0 += buckets[j].count;
-            }
-            for (int j = i+1; j < nBuckets; ++j) {
-                b1 = Union(b1, buckets[j].bound);
-                count1 += buckets[j].count;
-            }
-            float cost = 1 +
-                      (count0 * b0.SurfaceArea() +
-                       count1 * b1.SurfaceArea()) /
-                              NodeBound.SurfaceArea();
-            if (cost < minCost) {
-                minCost = cost;
-                minCostSplit = i;
-            }
+        /* cost of splitting after every bucket, sweeping from both ends */
+        float costs[N_BUCKETS - 1];
+        Bounds3 below, above;
+        int countBelow = 0, countAbove = 0;
+        for (int i = 0; i < N_BUCKETS - 1; ++i) {
+            below = Union(below, buckets[i].bound);
+            countBelow += buckets[i].count;
+            costs[i] = countBelow * below.SurfaceArea();
         }
-
-
-        switch (dim) {
-            case 0:
-                std::sort(&shapes[begin] , &shapes[end - 1] + 1, [](auto f1, auto f2) {
-                    return f1->WorldBound().Centroid().x <
-                           f2->WorldBound().Centroid().x;
-                });
-                break;
-            case 1:
-                std::sort(&shapes[begin] , &shapes[end - 1] + 1, [](auto f1, auto f2) {
-                    return f1->WorldBound().Centroid().y <
-                           f2->WorldBound().Centroid().y;
-                });
-                break;
-            case 2:
-                std::sort(&shapes[begin] , &shapes[end - 1] + 1, [](auto f1, auto f2) {
-                    return f1->WorldBound().Centroid().z <
-                           f2->WorldBound().Centroid().z;
-                });
-                break;
+        for (int i = N_BUCKETS - 1; i > 0; --i) {
+            above = Union(above, buckets[i].bound);
+            countAbove += buckets[i].count;
+            costs[i - 1] += countAbove * above.SurfaceArea();
         }
+        int minCostSplit = 0;
+        for (int i = 1; i < N_BUCKETS - 1; ++i)
+            if (costs[i] < costs[minCostSplit])
+                minCostSplit = i;
+        float minCost = TRAVERSAL_COST + costs[minCostSplit] / NodeBound.SurfaceArea();
+        if (count <= int(maxShapeInNode) && minCost >= float(count))
+            return makeLeaf();
 
+        /* the first and last buckets hold the extreme centroids, neither
+           side is empty */
         auto pmid = std::partition(
-            &shapes[begin] , &shapes[end - 1] + 1,
-            [=](Shape *shape) {
-                int b = nBuckets * centroidBounds.Offset(shape->WorldBound().Centroid())[dim];
-                if (b == nBuckets)
-                    b = nBuckets - 1;
-                CHECK_GE(b, 0);
-                CHECK_LT(b, nBuckets);
-                return b <= minCostSplit;
-            }
+            primitives.begin() + begin, primitives.begin() + end,
+            [&](const BVHPrimitive &primitive) { return bucket(primitive, centroidBounds, dim) <= minCostSplit; }
         );
-        int mid = pmid - &shapes[0];
-
-        CHECK_GT(mid, begin);
-        CHECK_LT(mid, end);
-
-        Node->left = BuildBVH(shapes, begin, mid);
-        Node->right = BuildBVH(shapes, mid, end);
+        mid = pmid - primitives.begin();
+    }
+    CHECK_GT(mid, begin);
+    CHECK_LT(mid, end);
 
-        Node->bound = Union(Node->left->bound, Node->right->bound);
+    (*nodes)[index].nShapes = 0;
+    (*nodes)[index].axis = dim;
+    if (count < PARALLEL_SHAPES) {
+        BuildBVH(primitives, begin, mid, depth + 1, maxShapeInNode, nodes);
+        (*nodes)[index].secondChildOffset = BuildBVH(primitives, mid, end, depth + 1, maxShapeInNode, nodes);
+        return index;
     }
 
-    return Node;
+    /* the second child is built by another task into its own nodes, then
+       moved behind the first child */
+    std::vector<LinearBVHNode> second;
+#pragma omp task default(shared)
+    BuildBVH(primitives, mid, end, depth + 1, maxShapeInNode, &second);
+    BuildBVH(primitives, begin, mid, depth + 1, maxShapeInNode, nodes);
+#pragma omp taskwait
+    uint32_t offset = nodes->size();
+    (*nodes)[index].secondChildOffset = offset;
+    for (LinearBVHNode &node : second) {
+        if (node.nShapes == 0)
+            node.secondChildOffset += offset;
+        nodes->push_back(node);
+    }
+    return index;
 }
 
 BVHUtils::BVHUtils(std::vector<Shape *> &shapes, unsigned int maxShapeInNode) :
@@ -131,25 +136,159 @@ BVHUtils::BVHUtils(std::vector<Shape *> &shapes, unsigned int maxShapeInNode) :
 {
     if (this->shapes.empty())
         return;
+    CHECK(maxShapeInNode >= 1 && maxShapeInNode <= UINT16_MAX) << "Invalid shapes per BVH leaf: " << maxShapeInNode;
     high_resolution_clock::time_point t0,t1;
-    double dt0=0.0;
 
     t0 = high_resolution_clock::now();
-    root = BuildBVH(this->shapes, 0, this->shapes.size());
+    const long long n = this->shapes.size();
+    std::vector<BVHPrimitive> primitives(n);
+#pragma omp parallel for schedule(static)
+    for (long long i = 0; i < n; ++i) {
+        primitives[i].bound = this->shapes[i]->WorldBound();
+        primitives[i].centroid = primitives[i].bound.Centroid();
+        primitives[i].index = uint32_t(i);
+    }
+
+    nodes.reserve(2 * n);
+#pragma omp parallel
+#pragma omp single
+    BuildBVH(primitives, 0, n, 0, maxShapeInNode, &nodes);
+
+    /* shapes in leaf order */
+    std::vector<Shape *> ordered(n);
+    shapeBounds.resize(n);
+    for (long long i = 0; i < n; ++i) {
+        ordered[i] = this->shapes[primitives[i].index];
+        shapeBounds[i] = primitives[i].bound;
+    }
+    this->shapes.swap(ordered);
     t1 = high_resolution_clock::now();
-    LOG(INFO) << "Building BVH finished: " << duration<double>(t1-t0).count() << " s";
+    LOG(INFO) << "Building BVH finished: " << duration<double>(t1-t0).count() << " s, "
+              << nodes.size() << " nodes";
 }
 
-bool BVHUtils::intersect(BVHNode *node, const Bounds3 &bbox) const {
-    if (!Overlaps(node->bound, bbox)) {
+BVHUtils::~BVHUtils() {
+    for (Shape *shape : shapes)
+        delete shape;
+}
+
+/* Call visit(i) for every shape i whose bound overlaps bbox, until it
+ * returns true; returns whether it did. */
+template <typename Visit>
+static bool traverse(const BVHUtils &bvh, const Bounds3 &bbox, Visit &&visit) {
+    if (bvh.nodes.empty())
         return false;
+    /* second children still to visit */
+    uint32_t stack[BVHUtils::MAX_DEPTH];
+    int top = 0;
+    uint32_t current = 0;
+    while (true) {
+        const LinearBVHNode &node = bvh.nodes[current];
+        if (node.overlaps(bbox)) {
+            if (node.nShapes == 0) {
+                stack[top++] = node.secondChildOffset;
+                current = current + 1;
+                continue;
+            }
+            for (uint32_t i = node.shapesOffset; i < node.shapesOffset + node.nShapes; ++i)
+                /* the bound of a single shape leaf is the shape's */
+                if ((node.nShapes == 1 || Overlaps(bvh.shapeBounds[i], bbox)) && visit(i))
+                    return true;
+        }
+        if (top == 0)
+            return false;
+        current = stack[--top];
     }
+}
 
-    if (node->left == nullptr && node->right == nullptr) {
-        return Overlaps(node->bound, bbox);
+bool BVHUtils::intersect(const Bounds3 &bbox) const {
+    return traverse(*this, bbox, [&](uint32_t i) { return shapes[i]->OverlapsBox(bbox); });
+}
+
+size_t BVHUtils::intersect(const Bounds3 &bbox, std::vector<Shape *> *hits) const {
+    size_t count = 0;
+    traverse(*this, bbox, [&](uint32_t i) {
+        if (shapes[i]->OverlapsBox(bbox)) {
+            hits->push_back(shapes[i]);
+            ++count;
+        }
+        return false;
+    });
+    return count;
+}
+
+/* Depth first walk of the nodes ray passes through, the child on the side
+ * the ray comes from first. visit(i) tests shape i and returns true to stop;
+ * returns whether it did. */
+template <typename Visit>
+static bool traverse(const BVHUtils &bvh, const Ray &ray, Visit &&visit) {
+    if (bvh.nodes.empty())
+        return false;
+    uint32_t stack[BVHUtils::MAX_DEPTH];
+    int top = 0;
+    uint32_t current = 0;
+    while (true) {
+        const LinearBVHNode &node = bvh.nodes[current];
+        /* ray.tMax shrinks as hits are found, culling farther nodes */
+        if (node.intersectP(ray)) {
+            if (node.nShapes == 0) {
+                if (ray.dirIsNeg[node.axis]) {
+                    stack[top++] = current + 1;
+                    current = node.secondChildOffset;
+                } else {
+                    stack[top++] = node.secondChildOffset;
+                    current = current + 1;
+                }
+                continue;
+            }
+            for (uint32_t i = node.shapesOffset; i < node.shapesOffset + node.nShapes; ++i)
+                if (visit(i))
+                    return true;
+        }
+        if (top == 0)
+            return false;
+        current = stack[--top];
     }
+}
+
+bool BVHUtils::intersect(const Ray &ray, RayHit *hit) const {
+    /* the search shrinks its own copy, the caller's ray is left alone */
+    Ray nearest = ray;
+    bool found = false;
+    traverse(*this, nearest, [&](uint32_t i) {
+        if (shapes[i]->Intersect(nearest, hit)) {
+            nearest.tMax = hit->t;
+            found = true;
+        }
+        return false;
+    });
+    return found;
+}
+
+bool BVHUtils::intersectP(const Ray &ray) const {
+    RayHit hit;
+    return traverse(*this, ray, [&](uint32_t i) { return shapes[i]->Intersect(ray, &hit); });
+}
+
+size_t BVHUtils::intersect(const Ray *rays, RayHit *hits, size_t count) const {
+    size_t found = 0;
+    /* ray costs vary a lot, hand out small chunks */
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : found) if (count > 256)
+    for (size_t n = 0; n < count; ++n) {
+        if (intersect(rays[n], &hits[n]))
+            ++found;
+        else
+            hits[n].t = std::numeric_limits<float>::infinity();
+    }
+    return found;
+}
 
-    bool hit0 = intersect(node->left, bbox);
-    bool hit1 = intersect(node->right, bbox);
-    return hit0 || hit1;
-}
\ No newline at end of file
+size_t BVHUtils::intersectP(const Ray *rays, uint8_t *hits, size_t count) const {
+    size_t found = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : found) if (count > 256)
+    for (size_t n = 0; n < count; ++n) {
+        hits[n] = intersectP(rays[n]);
+        found += hits[n];
+    }
+    return found;
+}
@@ -2,6 +2,9 @@
 #include "litewq/math/BoundingBox.h"
 #include "litewq/mesh/TriMesh.h"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace litewq;
 
 Bounds3 Shape::WorldBound() {
@@ -14,4 +17,90 @@ Bounds3 Triangle::ObjectBound() {
     return Union(Bounds3(mesh->global_vertices_[v[0]].position_,
                          mesh->global_vertices_[v[1]].position_),
                  mesh->global_vertices_[v[2]].position_);
-}
\ No newline at end of file
+}
+
+bool Shape::OverlapsBox(const Bounds3 &bbox) {
+    return Overlaps(WorldBound(), bbox);
+}
+
+glm::vec3 Triangle::WorldVertex(int i) const {
+    return glm::vec3(*ObjectToWorld * glm::vec4(mesh->global_vertices_[v[i]].position_, 1.0f));
+}
+
+bool Triangle::OverlapsBox(const Bounds3 &bbox) {
+    return TriangleOverlapsBox(WorldVertex(0), WorldVertex(1), WorldVertex(2), bbox);
+}
+
+bool Triangle::Intersect(const Ray &ray, RayHit *hit) {
+    /* vertices relative to the ray origin, permuted and sheared so the ray
+       runs along +z from the origin */
+    glm::vec3 p[3];
+    for (int i = 0; i < 3; ++i) {
+        glm::vec3 q = WorldVertex(i) - ray.o;
+        p[i] = glm::vec3(q[ray.kx] + ray.shear.x * q[ray.kz], q[ray.ky] + ray.shear.y * q[ray.kz], q[ray.kz]);
+    }
+
+    /* edge functions, exact zeros are redone in double so rays through an
+       edge are decided the same way for both of its triangles */
+    float e0 = p[1].x * p[2].y - p[1].y * p[2].x;
+    float e1 = p[2].x * p[0].y - p[2].y * p[0].x;
+    float e2 = p[0].x * p[1].y - p[0].y * p[1].x;
+    if (e0 == 0.0f || e1 == 0.0f || e2 == 0.0f) {
+        e0 = float(double(p[1].x) * double(p[2].y) - double(p[1].y) * double(p[2].x));
+        e1 = float(double(p[2].x) * double(p[0].y) - double(p[2].y) * double(p[0].x));
+        e2 = float(double(p[0].x) * double(p[1].y) - double(p[0].y) * double(p[1].x));
+    }
+    if ((e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) && (e0 > 0.0f || e1 > 0.0f || e2 > 0.0f))
+        return false;
+    float det = e0 + e1 + e2;
+    if (det == 0.0f)
+        return false;
+
+    /* t scaled by det, compared without dividing */
+    float tScaled = ray.shear.z * (e0 * p[0].z + e1 * p[1].z + e2 * p[2].z);
+    if (det < 0.0f && (tScaled >= 0.0f || tScaled < ray.tMax * det))
+        return false;
+    if (det > 0.0f && (tScaled <= 0.0f || tScaled > ray.tMax * det))
+        return false;
+
+    float invDet = 1.0f / det;
+    hit->t = tScaled * invDet;
+    hit->barycentric = glm::vec3(e0, e1, e2) * invDet;
+    hit->position = ray(hit->t);
+    hit->shape = this;
+    hit->triangle = unsigned(v - mesh->global_indices_.data()) / 3;
+    hit->submesh = mesh->submeshOf(3 * hit->triangle);
+    return true;
+}
+
+/* Whether the projections of the triangle and the box on axis overlap, the
+ * triangle relative to the box center, h the box half extents. */
+static inline bool overlapOnAxis(const glm::vec3 &axis, const glm::vec3 &v0, const glm::vec3 &v1,
+                                 const glm::vec3 &v2, const glm::vec3 &h) {
+    float p0 = glm::dot(axis, v0), p1 = glm::dot(axis, v1), p2 = glm::dot(axis, v2);
+    float r = h.x * std::abs(axis.x) + h.y * std::abs(axis.y) + h.z * std::abs(axis.z);
+    return std::min(p0, std::min(p1, p2)) <= r && std::max(p0, std::max(p1, p2)) >= -r;
+}
+
+bool litewq::TriangleOverlapsBox(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2,
+                                 const Bounds3 &bbox) {
+    /* the box normals: the bounds of the triangle against the box */
+    if (!Overlaps(Union(Bounds3(v0, v1), v2), bbox))
+        return false;
+
+    const glm::vec3 c = bbox.Centroid(), h = 0.5f * bbox.Diagonal();
+    const glm::vec3 a = v0 - c, b = v1 - c, d = v2 - c;
+    const glm::vec3 e0 = b - a, e1 = d - b, e2 = a - d;
+    /* the triangle normal */
+    if (!overlapOnAxis(glm::cross(e0, e1), a, b, d, h))
+        return false;
+    /* every box axis crossed with every edge */
+    const glm::vec3 edges[3] = {e0, e1, e2};
+    for (const glm::vec3 &edge : edges) {
+        if (!overlapOnAxis(glm::vec3(0.0f, -edge.z, edge.y), a, b, d, h) ||
+            !overlapOnAxis(glm::vec3(edge.z, 0.0f, -edge.x), a, b, d, h) ||
+            !overlapOnAxis(glm::vec3(-edge.y, edge.x, 0.0f), a, b, d, h))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#include "litewq/math/SpatialHash.h"
+#include "litewq/utils/logging.h"
+
+#include <algorithm>
+
+using namespace litewq;
+
+SpatialHash::SpatialHash(float cell_size, size_t buckets) : cell_size_(cell_size) {
+    CHECK(cell_size > 0.0f && buckets > 0) << "Invalid spatial hash";
+    size_t size = 1;
+    while (size < buckets)
+        size <<= 1;
+    mask_ = size - 1;
+    bucket_start_.assign(size + 1, 0);
+}
+
+void SpatialHash::clear() {
+    pending_.clear();
+    entries_.clear();
+    std::fill(bucket_start_.begin(), bucket_start_.end(), 0);
+}
+
+void SpatialHash::insert(uint32_t id, const glm::vec2 &min, const glm::vec2 &max) {
+    glm::ivec2 lo = cell(min), hi = cell(max);
+    for (int x = lo.x; x <= hi.x; ++x)
+        for (int z = lo.y; z <= hi.y; ++z)
+            pending_.emplace_back(uint32_t(bucket(x, z)), id);
+}
+
+void SpatialHash::build() {
+    /* counting sort by bucket of the packed and the pending objects */
+    std::vector<std::pair<uint32_t, uint32_t>> all;
+    all.reserve(entries_.size());
+    for (size_t b = 0; b + 1 < bucket_start_.size(); ++b)
+        for (uint32_t e = bucket_start_[b]; e < bucket_start_[b + 1]; ++e)
+            all.emplace_back(uint32_t(b), entries_[e]);
+    all.insert(all.end(), pending_.begin(), pending_.end());
+    pending_.clear();
+
+    std::fill(bucket_start_.begin(), bucket_start_.end(), 0);
+    for (const auto &entry : all)
+        bucket_start_[entry.first + 1]++;
+    for (size_t b = 1; b < bucket_start_.size(); ++b)
+        bucket_start_[b] += bucket_start_[b - 1];
+    entries_.resize(all.size());
+    std::vector<uint32_t> next(bucket_start_.begin(), bucket_start_.end() - 1);
+    for (const auto &entry : all)
+        entries_[next[entry.first]++] = entry.second;
+}
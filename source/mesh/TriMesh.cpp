@@ -3,11 +3,15 @@
 #include "litewq/platform/OpenGL/GLShader.h"
 #include "litewq/surface/WavefrontOBJ.h"
 
+#include <glm/gtx/hash.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include "litewq/utils/logging.h"
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 using namespace litewq;
 
 
@@ -212,6 +216,39 @@ void TriMesh::initGL() {
 
     /* Unbind VAO */
     glBindVertexArray(0);
+
+    /* Depth stream: OBJ corners duplicate their vertex, welding the
+     * positions shrinks the stream and lets the post-transform cache hit. */
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> depth_indices(global_indices_.size());
+    std::unordered_map<glm::vec3, unsigned int> welded;
+    for (size_t i = 0; i < global_indices_.size(); ++i) {
+        const glm::vec3 &position = global_vertices_[global_indices_[i]].position_;
+        auto found = welded.emplace(position, (unsigned int)positions.size());
+        if (found.second)
+            positions.push_back(position);
+        depth_indices[i] = found.first->second;
+    }
+
+    glGenVertexArrays(1, &DepthVAO);
+    glGenBuffers(1, &DepthVBO);
+    glGenBuffers(1, &DepthEBO);
+    glBindVertexArray(DepthVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, DepthVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, DepthEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, depth_indices.size() * sizeof(unsigned int),
+                 depth_indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+    glBindVertexArray(0);
+}
+
+unsigned int TriMesh::submeshOf(unsigned int index) const {
+    /* submeshes are stored in index order */
+    auto it = std::upper_bound(offsets_.begin(), offsets_.end(), index,
+                               [](unsigned int i, const SubMeshArea &submesh) { return i < submesh.index_offset_; });
+    return it == offsets_.begin() ? 0 : unsigned(it - offsets_.begin()) - 1;
 }
 
 void TriMesh::buildBVH() {
@@ -240,10 +277,22 @@ void TriMesh::render() {
     glBindVertexArray(0);
 }
 
+void TriMesh::renderDepth() {
+    /* the depth program bound by the pass, never the mesh's own shader */
+    GLShader *current = GLShader::GetCurrentShader();
+    glBindVertexArray(DepthVAO);
+    current->updateUniformMat4("model", model);
+    glDrawElements(GL_TRIANGLES, global_indices_.size(), GL_UNSIGNED_INT, (void *)0);
+    glBindVertexArray(0);
+}
+
 void TriMesh::finishGL() {
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
     glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &DepthVBO);
+    glDeleteBuffers(1, &DepthEBO);
+    glDeleteVertexArrays(1, &DepthVAO);
 }
 
 
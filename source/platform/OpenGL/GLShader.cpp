@@ -15,15 +15,35 @@ GLShader *GLShader::GetCurrentShader() {
     return current;
 }
 
+std::string GLShader::platformSource(const std::string &source) {
+#ifdef LITEWQ_GLES
+    const std::string desktop = "#version 330 core";
+    if (source.compare(0, desktop.size(), desktop) == 0)
+        return "#version 300 es\n"
+               "precision highp float;\n"
+               "precision highp int;\n"
+               "precision highp sampler2D;\n"
+               "precision highp sampler2DArray;\n"
+               "precision highp sampler2DShadow;\n"
+               "precision highp sampler2DArrayShadow;\n"
+               "precision highp isampler2D;\n"
+               "precision highp usampler2D;\n" + source.substr(desktop.size());
+#endif
+    return source;
+}
+
 GLShader::~GLShader() {
     glDeleteProgram(render_id_);
 }
 
-GLShader::GLShader(const std::string &vertex_src, const std::string &frag_src) {
+GLShader::GLShader(const std::string &vertex_src, const std::string &frag_src,
+                   const std::vector<std::string> &feedback_varyings) {
         GLint success;
         GLchar infoLog[1024];
-        const char *vertex_code = vertex_src.c_str();
-        const char *frag_code = frag_src.c_str();
+        const std::string vertex_platform = platformSource(vertex_src);
+        const std::string frag_platform = platformSource(frag_src);
+        const char *vertex_code = vertex_platform.c_str();
+        const char *frag_code = frag_platform.c_str();
         // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
@@ -53,6 +73,13 @@ GLShader::GLShader(const std::string &vertex_src, const std::string &frag_src) {
         render_id_ = glCreateProgram();
         glAttachShader(render_id_, vertex);
         glAttachShader(render_id_, fragment);
+        if (!feedback_varyings.empty())
+        {
+            std::vector<const char *> varyings;
+            for (const std::string &varying : feedback_varyings)
+                varyings.push_back(varying.c_str());
+            glTransformFeedbackVaryings(render_id_, GLsizei(varyings.size()), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+        }
         glLinkProgram(render_id_);
 
         glGetProgramiv(render_id_, GL_LINK_STATUS, &success);
@@ -86,6 +113,11 @@ void GLShader::updateUniformFloat(const std::string &name, const float value) {
     GL_CHECK(glUniform1f(location, value));
 }
 
+void GLShader::updateUniformFloat2(const std::string &name, const glm::vec2 &vec) {
+    GLint location = glGetUniformLocation(render_id_, name.c_str());
+    GL_CHECK(glUniform2f(location, vec.x, vec.y));
+}
+
 void GLShader::updateUniformFloat3(const std::string &name, const glm::vec3 &vec) {
     GLint location = glGetUniformLocation(render_id_, name.c_str());
     GL_CHECK(glUniform3f(location, vec.x, vec.y, vec.z));
@@ -0,0 +1,31 @@
+#include "litewq/platform/OpenGL/GLTimer.h"
+#include "litewq/platform/OpenGL/GLErrorHandle.h"
+
+#include "glad/glad.h"
+
+using namespace litewq;
+
+void GLTimer::initGL() {
+    glGenQueries(LATENCY, queries_);
+}
+
+void GLTimer::finishGL() {
+    glDeleteQueries(LATENCY, queries_);
+}
+
+void GLTimer::begin() {
+    unsigned int query = queries_[frame_ % LATENCY];
+    /* the query issued LATENCY frames ago, normally finished by now */
+    if (frame_ >= LATENCY) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        total_ms_ += double(ns) * 1e-6;
+        ++samples_;
+    }
+    GL_CHECK(glBeginQuery(GL_TIME_ELAPSED, query));
+}
+
+void GLTimer::end() {
+    GL_CHECK(glEndQuery(GL_TIME_ELAPSED));
+    ++frame_;
+}
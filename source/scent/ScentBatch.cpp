@@ -0,0 +1,154 @@
+#include "litewq/scent/ScentBatch.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLErrorHandle.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace litewq;
+
+/* below this many instances sort() stays on one thread */
+static constexpr size_t PARALLEL_INSTANCES = 8192;
+
+void ScentBatch::initGL() {
+    /* quad corners, drawn as a triangle strip */
+    const glm::vec2 corners[4] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {-1.0f, 1.0f}, {1.0f, 1.0f}};
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quad_VBO);
+    glGenBuffers(1, &instance_VBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
+
+    /* position and size, color: advance once per instance */
+    glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, position));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, color));
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+}
+
+void ScentBatch::finishGL() {
+    glDeleteBuffers(1, &quad_VBO);
+    glDeleteBuffers(1, &instance_VBO);
+    glDeleteVertexArrays(1, &VAO);
+    capacity_ = 0;
+}
+
+void ScentBatch::sort(const glm::mat4 &view) {
+    const size_t n = instances_.size();
+    if (n < 2)
+        return;
+    for (int i = 0; i < 2; ++i) {
+        keys_[i].resize(n);
+        order_[i].resize(n);
+    }
+
+    /* depth along the view direction, -z in view space */
+    const glm::vec4 depth_row(view[0][2], view[1][2], view[2][2], view[3][2]);
+    float near_depth = std::numeric_limits<float>::max(), far_depth = std::numeric_limits<float>::lowest();
+    const long long count = (long long)n;
+#pragma omp parallel for simd reduction(min : near_depth) reduction(max : far_depth) if (n >= PARALLEL_INSTANCES)
+    for (long long i = 0; i < count; ++i) {
+        float depth = -glm::dot(depth_row, glm::vec4(instances_[i].position, 1.0f));
+        near_depth = std::min(near_depth, depth);
+        far_depth = std::max(far_depth, depth);
+    }
+    /* farthest first: the key grows as the depth shrinks */
+    const float scale = far_depth > near_depth ? 65535.0f / (far_depth - near_depth) : 0.0f;
+#pragma omp parallel for simd if (n >= PARALLEL_INSTANCES)
+    for (long long i = 0; i < count; ++i) {
+        float depth = -glm::dot(depth_row, glm::vec4(instances_[i].position, 1.0f));
+        keys_[0][i] = uint16_t((far_depth - depth) * scale);
+        order_[0][i] = uint32_t(i);
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    if (n >= PARALLEL_INSTANCES)
+        threads = omp_get_max_threads();
+#endif
+    /* per thread digit counts, turned into scatter offsets; thread t owns a
+       contiguous chunk so the passes stay stable. The team may be smaller
+       than asked for, so chunks are cut for the threads actually running */
+    std::vector<size_t> offsets(size_t(threads) * 256);
+    for (int pass = 0; pass < 2; ++pass) {
+        const int shift = pass * 8;
+        const uint16_t *keys = keys_[pass].data();
+        const uint32_t *order = order_[pass].data();
+        uint16_t *keys_out = keys_[1 - pass].data();
+        uint32_t *order_out = order_[1 - pass].data();
+        std::fill(offsets.begin(), offsets.end(), 0);
+#pragma omp parallel num_threads(threads)
+        {
+            int t = 0, team = 1;
+#ifdef _OPENMP
+            t = omp_get_thread_num();
+            team = omp_get_num_threads();
+#endif
+            size_t begin = n * t / team, end = n * (t + 1) / team;
+            size_t *count_t = &offsets[size_t(t) * 256];
+            for (size_t i = begin; i < end; ++i)
+                count_t[(keys[i] >> shift) & 0xff]++;
+#pragma omp barrier
+#pragma omp single
+            {
+                size_t sum = 0;
+                for (int digit = 0; digit < 256; ++digit)
+                    for (int u = 0; u < team; ++u) {
+                        size_t c = offsets[size_t(u) * 256 + digit];
+                        offsets[size_t(u) * 256 + digit] = sum;
+                        sum += c;
+                    }
+            }
+            for (size_t i = begin; i < end; ++i) {
+                size_t dst = count_t[(keys[i] >> shift) & 0xff]++;
+                keys_out[dst] = keys[i];
+                order_out[dst] = order[i];
+            }
+        }
+    }
+
+    /* two passes: the result is back in keys_[0] / order_[0] */
+    sorted_.resize(n);
+    const uint32_t *order = order_[0].data();
+#pragma omp parallel for if (n >= PARALLEL_INSTANCES)
+    for (long long i = 0; i < count; ++i)
+        sorted_[i] = instances_[order[i]];
+    instances_.swap(sorted_);
+}
+
+void ScentBatch::render(GLShader &shader, const glm::mat4 &view, const glm::mat4 &projection) {
+    if (instances_.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+    /* orphan the old storage instead of waiting for draws still reading it */
+    capacity_ = std::max(capacity_, instances_.size());
+    glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances_.size() * sizeof(Instance), instances_.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    shader.Bind();
+    shader.updateUniformMat4("view", view);
+    shader.updateUniformMat4("projection", projection);
+    glEnable(GL_BLEND);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(VAO);
+    GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(instances_.size())));
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
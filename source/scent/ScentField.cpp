@@ -0,0 +1,194 @@
+#include "litewq/scent/ScentField.h"
+#include "litewq/utils/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace litewq;
+
+/* below this many queries sample() stays on one thread */
+static constexpr size_t PARALLEL_QUERIES = 1024;
+
+ScentField::ScentField(const glm::vec3 &origin, float cell_size, int rows, int cols, int layers, float layer_height)
+    : origin_(origin), cell_size_(cell_size), layer_height_(layer_height),
+      rows_(rows), cols_(cols), layers_(layers) {
+    /* the bilinear stencils need a neighbour along each axis */
+    CHECK(rows > 1 && cols > 1 && layers > 0) << "Invalid scent field: " << rows << "x" << cols << "x" << layers;
+    CHECK(cell_size > 0.0f && layer_height > 0.0f) << "Invalid scent field cell size";
+    size_t cells = size_t(rows) * cols * layers;
+    wind_x_.assign(cells, 0.0f);
+    wind_z_.assign(cells, 0.0f);
+    concentration_.assign(cells, 0.0f);
+    advected_.assign(cells, 0.0f);
+    jacobi_.assign(cells, 0.0f);
+    published_.assign(cells, 0.0f);
+}
+
+void ScentField::setWind(const glm::vec3 &wind) {
+    std::fill(wind_x_.begin(), wind_x_.end(), wind.x);
+    std::fill(wind_z_.begin(), wind_z_.end(), wind.z);
+}
+
+void ScentField::clear() {
+    std::fill(concentration_.begin(), concentration_.end(), 0.0f);
+}
+
+void ScentField::inject(const glm::vec3 &position, float amount) {
+    /* continuous cell coordinates, integers at cell centers */
+    float u = (position.x - origin_.x) / cell_size_ - 0.5f;
+    float v = (position.z - origin_.z) / cell_size_ - 0.5f;
+    float w = (position.y - origin_.y) / layer_height_ - 0.5f;
+    if (!inside(u, v, w))
+        return;
+    u = glm::clamp(u, 0.0f, float(rows_ - 1));
+    v = glm::clamp(v, 0.0f, float(cols_ - 1));
+    w = glm::clamp(w, 0.0f, float(layers_ - 1));
+    int i0 = std::min(int(u), rows_ - 2), j0 = std::min(int(v), cols_ - 2);
+    int k0 = std::min(int(w), std::max(layers_ - 2, 0)), k1 = std::min(k0 + 1, layers_ - 1);
+    float fx = u - i0, fz = v - j0, fy = layers_ > 1 ? w - k0 : 0.0f;
+    for (int k = 0; k < 2; ++k) {
+        float wk = (k ? fy : 1.0f - fy) * amount;
+        int layer = k ? k1 : k0;
+        concentration_[index(layer, i0, j0)] += wk * (1.0f - fx) * (1.0f - fz);
+        concentration_[index(layer, i0 + 1, j0)] += wk * fx * (1.0f - fz);
+        concentration_[index(layer, i0, j0 + 1)] += wk * (1.0f - fx) * fz;
+        concentration_[index(layer, i0 + 1, j0 + 1)] += wk * fx * fz;
+    }
+}
+
+void ScentField::step(float dt) {
+    advect(dt);
+    diffuse(dt);
+}
+
+void ScentField::advect(float dt) {
+    const float scale = dt / cell_size_;
+    const float max_row = float(rows_ - 1), max_col = float(cols_ - 1);
+    const int rows = rows_, cols = cols_;
+#pragma omp parallel for schedule(static)
+    for (int lr = 0; lr < layers_ * rows_; ++lr) {
+        const int layer = lr / rows, row = lr % rows;
+        const float *src = &concentration_[index(layer, 0, 0)];
+        const float *wind_x = &wind_x_[index(layer, row, 0)];
+        const float *wind_z = &wind_z_[index(layer, row, 0)];
+        float *dst = &advected_[index(layer, row, 0)];
+#pragma omp simd
+        for (int col = 0; col < cols; ++col) {
+            /* where the value arriving here was dt ago */
+            float u = glm::clamp(float(row) - wind_x[col] * scale, 0.0f, max_row);
+            float v = glm::clamp(float(col) - wind_z[col] * scale, 0.0f, max_col);
+            int i0 = std::min(int(u), rows - 2), j0 = std::min(int(v), cols - 2);
+            float fx = u - float(i0), fz = v - float(j0);
+            const float *r0 = src + size_t(i0) * cols, *r1 = r0 + cols;
+            float a = r0[j0] + (r1[j0] - r0[j0]) * fx;
+            float b = r0[j0 + 1] + (r1[j0 + 1] - r0[j0 + 1]) * fx;
+            dst[col] = a + (b - a) * fz;
+        }
+    }
+}
+
+void ScentField::diffuse(float dt) {
+    /* backward Euler: (1 + decay dt) c - diffusion dt laplacian(c) = advected,
+       missing neighbours at the border take no flux */
+    const float a_h = diffusion_ * dt / (cell_size_ * cell_size_);
+    const float a_v = layers_ > 1 ? diffusion_ * dt / (layer_height_ * layer_height_) : 0.0f;
+    const float inv_diagonal = 1.0f / (1.0f + decay_ * dt + 4.0f * a_h + 2.0f * a_v);
+    const int rows = rows_, cols = cols_;
+
+    std::copy(advected_.begin(), advected_.end(), concentration_.begin());
+    for (int iteration = 0; iteration < iterations_; ++iteration) {
+        const std::vector<float> &x = concentration_;
+        std::vector<float> &out = jacobi_;
+#pragma omp parallel for schedule(static)
+        for (int lr = 0; lr < layers_ * rows_; ++lr) {
+            const int layer = lr / rows, row = lr % rows;
+            const float *center = &x[index(layer, row, 0)];
+            const float *up = row > 0 ? center - cols : center;
+            const float *down = row < rows - 1 ? center + cols : center;
+            const float *below = layer > 0 ? &x[index(layer - 1, row, 0)] : center;
+            const float *above = layer < layers_ - 1 ? &x[index(layer + 1, row, 0)] : center;
+            const float *b = &advected_[index(layer, row, 0)];
+            float *result = &out[index(layer, row, 0)];
+
+            result[0] = (b[0] + a_h * (up[0] + down[0] + center[0] + center[1]) +
+                         a_v * (below[0] + above[0])) * inv_diagonal;
+#pragma omp simd
+            for (int col = 1; col < cols - 1; ++col)
+                result[col] = (b[col] + a_h * (up[col] + down[col] + center[col - 1] + center[col + 1]) +
+                               a_v * (below[col] + above[col])) * inv_diagonal;
+            const int last = cols - 1;
+            result[last] = (b[last] + a_h * (up[last] + down[last] + center[last - 1] + center[last]) +
+                            a_v * (below[last] + above[last])) * inv_diagonal;
+        }
+        concentration_.swap(jacobi_);
+    }
+}
+
+float ScentField::concentration(const glm::vec3 &position) const {
+    float c;
+    sample(&position, 1, &c, nullptr);
+    return c;
+}
+
+void ScentField::sample(const glm::vec3 *positions, size_t count, float *concentration, glm::vec3 *gradient) const {
+    sample(concentration_, positions, count, concentration, gradient);
+}
+
+void ScentField::publish() {
+    /* copy outside the lock, queries only wait for the swap */
+    back_ = concentration_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    published_.swap(back_);
+}
+
+float ScentField::concentrationSnapshot(const glm::vec3 &position) const {
+    float c;
+    sampleSnapshot(&position, 1, &c, nullptr);
+    return c;
+}
+
+void ScentField::sampleSnapshot(const glm::vec3 *positions, size_t count, float *concentration,
+                                glm::vec3 *gradient) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sample(published_, positions, count, concentration, gradient);
+}
+
+void ScentField::sample(const std::vector<float> &grid, const glm::vec3 *positions, size_t count,
+                        float *concentration, glm::vec3 *gradient) const {
+    const long long n = (long long)count;
+#pragma omp parallel for schedule(static) if (count >= PARALLEL_QUERIES)
+    for (long long q = 0; q < n; ++q) {
+        const glm::vec3 &p = positions[q];
+        float u = (p.x - origin_.x) / cell_size_ - 0.5f;
+        float v = (p.z - origin_.z) / cell_size_ - 0.5f;
+        float w = (p.y - origin_.y) / layer_height_ - 0.5f;
+        if (!inside(u, v, w)) {
+            concentration[q] = 0.0f;
+            if (gradient)
+                gradient[q] = glm::vec3(0.0f);
+            continue;
+        }
+        u = glm::clamp(u, 0.0f, float(rows_ - 1));
+        v = glm::clamp(v, 0.0f, float(cols_ - 1));
+        w = glm::clamp(w, 0.0f, float(layers_ - 1));
+        int i0 = std::min(int(u), rows_ - 2), j0 = std::min(int(v), cols_ - 2);
+        int k0 = std::min(int(w), std::max(layers_ - 2, 0)), k1 = std::min(k0 + 1, layers_ - 1);
+        float fx = u - i0, fz = v - j0, fy = layers_ > 1 ? w - k0 : 0.0f;
+
+        /* bilinear value and its derivatives along x and z in each layer */
+        float value[2], dx[2], dz[2];
+        for (int k = 0; k < 2; ++k) {
+            const float *r0 = &grid[index(k ? k1 : k0, i0, j0)], *r1 = r0 + cols_;
+            float a = r0[0] + (r1[0] - r0[0]) * fx;
+            float b = r0[1] + (r1[1] - r0[1]) * fx;
+            value[k] = a + (b - a) * fz;
+            dx[k] = (r1[0] - r0[0]) + ((r1[1] - r0[1]) - (r1[0] - r0[0])) * fz;
+            dz[k] = b - a;
+        }
+        concentration[q] = value[0] + (value[1] - value[0]) * fy;
+        if (gradient)
+            gradient[q] = glm::vec3((dx[0] + (dx[1] - dx[0]) * fy) / cell_size_,
+                                    (value[1] - value[0]) / layer_height_,
+                                    (dz[0] + (dz[1] - dz[0]) * fy) / cell_size_);
+    }
+}
@@ -0,0 +1,137 @@
+#include "litewq/scent/ScentGPU.h"
+#include "litewq/scent/WindField.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLErrorHandle.h"
+#include "litewq/utils/logging.h"
+
+#include <glad/glad.h>
+
+#include <random>
+
+using namespace litewq;
+
+ScentGPU::ScentGPU(GLShader &update_shader, float lifetime, float decay)
+    : update_shader_(update_shader), lifetime_(lifetime), decay_(decay) {}
+
+int ScentGPU::addSource(const glm::vec3 &origin, const glm::vec3 &direction, int length, size_t budget) {
+    CHECK(sources_.size() < MAX_SOURCES) << "Too many scent sources: " << sources_.size();
+    CHECK(state_VBO_[0] == 0) << "Scent sources are added before initGL()";
+    capacity_ += budget;
+    Source source;
+    source.origin = origin;
+    source.direction = direction;
+    source.length = length;
+    source.end = capacity_;
+    sources_.push_back(source);
+    return int(sources_.size()) - 1;
+}
+
+void ScentGPU::initGL() {
+    CHECK(capacity_ > 0) << "No scent sources";
+
+    /* unborn particles: negative ages spread the first spawns over a lifetime */
+    std::vector<Particle> particles(capacity_);
+    std::default_random_engine generator(capacity_);
+    std::uniform_real_distribution<float> age_distribution(-lifetime_, 0.0f);
+    for (Particle &particle : particles) {
+        particle.position_age = glm::vec4(0.0f, 0.0f, 0.0f, age_distribution(generator));
+        particle.velocity = glm::vec4(0.0f);
+        particle.sprite = glm::vec4(0.0f);
+        particle.color = glm::vec4(0.0f);
+    }
+
+    const glm::vec2 corners[4] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {-1.0f, 1.0f}, {1.0f, 1.0f}};
+    glGenBuffers(1, &quad_VBO_);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_VBO_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+    glGenBuffers(2, state_VBO_);
+    glGenVertexArrays(2, update_VAO_);
+    glGenVertexArrays(2, render_VAO_);
+    for (int i = 0; i < 2; ++i) {
+        glBindBuffer(GL_ARRAY_BUFFER, state_VBO_[i]);
+        glBufferData(GL_ARRAY_BUFFER, particles.size() * sizeof(Particle), particles.data(), GL_DYNAMIC_COPY);
+
+        /* simulation input: the state half of a particle */
+        glBindVertexArray(update_VAO_[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, position_age));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, velocity));
+
+        /* drawing: quad corners plus the sprite half as instance attributes,
+           the layout ScentBatch uses */
+        glBindVertexArray(render_VAO_[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, quad_VBO_);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
+        glBindBuffer(GL_ARRAY_BUFFER, state_VBO_[i]);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, sprite));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, color));
+        glVertexAttribDivisor(2, 1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    current_ = 0;
+    time_ = 0.0;
+}
+
+void ScentGPU::finishGL() {
+    glDeleteVertexArrays(2, update_VAO_);
+    glDeleteVertexArrays(2, render_VAO_);
+    glDeleteBuffers(2, state_VBO_);
+    glDeleteBuffers(1, &quad_VBO_);
+    state_VBO_[0] = state_VBO_[1] = 0;
+}
+
+void ScentGPU::update(float dt) {
+    time_ += dt;
+    update_shader_.Bind();
+    update_shader_.updateUniformFloat("time", float(time_));
+    update_shader_.updateUniformFloat("dt", dt);
+    update_shader_.updateUniformFloat("lifetime", lifetime_);
+    update_shader_.updateUniformFloat("decay", decay_);
+    update_shader_.updateUniformFloat("size", size_);
+    update_shader_.updateUniformFloat4("color", glm::vec4(color_, intensity_));
+    /* still air skips the field in the shader altogether */
+    update_shader_.updateUniformInt("windEnabled", wind_ != nullptr);
+    if (wind_)
+        wind_->setUniforms(update_shader_, wind_tex_unit_);
+    update_shader_.updateUniformInt("sourceCount", int(sources_.size()));
+    for (size_t i = 0; i < sources_.size(); ++i) {
+        const Source &source = sources_[i];
+        std::string index = "[" + std::to_string(i) + "]";
+        update_shader_.updateUniformInt("sourceEnd" + index, int(source.end));
+        update_shader_.updateUniformFloat4("sourceOrigin" + index, glm::vec4(source.origin, float(source.length)));
+        update_shader_.updateUniformFloat3("sourceDirection" + index, source.direction);
+    }
+
+    /* read the current buffer, capture into the other one */
+    int next = 1 - current_;
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(update_VAO_[current_]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, state_VBO_[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    GL_CHECK(glDrawArrays(GL_POINTS, 0, GLsizei(capacity_)));
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    current_ = next;
+}
+
+void ScentGPU::render(GLShader &shader, const glm::mat4 &view, const glm::mat4 &projection) {
+    shader.Bind();
+    shader.updateUniformMat4("view", view);
+    shader.updateUniformMat4("projection", projection);
+    glEnable(GL_BLEND);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(render_VAO_[current_]);
+    GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(capacity_)));
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,328 @@
+#include "litewq/scent/ScentManager.h"
+#include "litewq/scent/ScentField.h"
+#include "litewq/math/Philox.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/utils/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace litewq;
+using namespace std::chrono;
+
+/* particles expire after a minute and fade to a third of their intensity by then */
+static constexpr float SCENT_LIFETIME = 60.0f;
+static constexpr float SCENT_DECAY = 0.02f;
+/* particles a marker emits per second and unit of strength without a field,
+   and per second and unit of concentration with one */
+static constexpr float SCENT_RATE = 0.05f;
+static constexpr float SCENT_EMISSION = 0.125f;
+/* steps update() runs at most per call, the simulation slows down rather than spiral */
+static constexpr int MAX_STEPS = 8;
+/* side of the spatial hash cells, about the length of a short track */
+static constexpr float HASH_CELL = 16.0f;
+/* emitters float above the ground */
+static const glm::vec3 EMITTER_RISE(0.0f, 0.6f, 0.0f);
+/* below this many visible sources the emission draws stay on one thread */
+static constexpr size_t PARALLEL_SOURCES = 64;
+
+/* what random numbers are drawn for, the last counter word; numbers not
+   owned by a source use the key NO_SOURCE */
+enum RandomStream : uint32_t { WIND_STREAM, EMIT_STREAM };
+static constexpr uint32_t NO_SOURCE = 0xffffffffu;
+
+static inline Philox::Counter scentRandom(uint32_t seed, uint32_t source, uint64_t count, uint32_t index,
+                                          RandomStream stream) {
+    return Philox::generate({uint32_t(count), uint32_t(count >> 32), index, stream}, {source, seed});
+}
+
+static glm::vec4 kindColor(ScentManager::SourceKind kind) {
+    switch (kind) {
+        case ScentManager::SourceKind::CARCASS:
+            return glm::vec4(0.62f, 0.12f, 0.10f, 1.0f);
+        case ScentManager::SourceKind::DEN:
+            return glm::vec4(0.55f, 0.40f, 0.25f, 1.0f);
+        case ScentManager::SourceKind::POST:
+            return glm::vec4(0.90f, 0.80f, 0.30f, 1.0f);
+        default:
+            return glm::vec4(0.95f, 0.54f, 0.21f, 1.0f);
+    }
+}
+
+ScentManager::ScentManager(GLShader &shader, size_t budget, uint32_t seed)
+    : shader_(shader), hash_(HASH_CELL, 4096), seed_(seed),
+      particles_(budget, SCENT_LIFETIME, SCENT_DECAY) {
+    /* the wind of tick 0 is drawn with the largest count, no step reaches it */
+    Philox::Counter r = scentRandom(seed_, NO_SOURCE, UINT64_MAX, 0, WIND_STREAM);
+    wind_ = glm::vec3(Philox::uniform(r[0]) - 0.5f, 0.0f, Philox::uniform(r[1]) - 0.5f);
+    emitter_begin_.push_back(0);
+}
+
+ScentManager::~ScentManager() {
+    stop();
+}
+
+int ScentManager::addTrack(const glm::vec3 &origin, const glm::vec3 &direction, int length,
+                           float strength, size_t budget) {
+    CHECK(!worker_.joinable()) << "Scent sources are added before start()";
+    CHECK(length > 0) << "Invalid scent track length: " << length;
+    uint32_t id = uint32_t(sources_.size());
+    sources_.push_back({SourceKind::TRACK, origin, glm::normalize(direction), length, strength, budget});
+    for (int i = 0; i < length; ++i)
+        emitters_.push_back(origin + sources_.back().direction * float(i) + EMITTER_RISE);
+    emitter_begin_.push_back(uint32_t(emitters_.size()));
+
+    glm::vec3 end = emitters_.back();
+    glm::vec2 a(origin.x, origin.z), b(end.x, end.z);
+    hash_.insert(id, glm::min(a, b), glm::max(a, b));
+    hash_built_ = false;
+    live_.push_back(0);
+    return int(id);
+}
+
+int ScentManager::addPoint(SourceKind kind, const glm::vec3 &position, float strength, size_t budget) {
+    CHECK(!worker_.joinable()) << "Scent sources are added before start()";
+    uint32_t id = uint32_t(sources_.size());
+    sources_.push_back({kind, position, glm::vec3(1.0f, 0.0f, 0.0f), 1, strength, budget});
+    emitters_.push_back(position + EMITTER_RISE);
+    emitter_begin_.push_back(uint32_t(emitters_.size()));
+    hash_.insert(id, glm::vec2(position.x, position.z));
+    hash_built_ = false;
+    live_.push_back(0);
+    return int(id);
+}
+
+void ScentManager::initGL() {
+    batch_.initGL();
+}
+
+void ScentManager::finishGL() {
+    batch_.finishGL();
+}
+
+void ScentManager::start() {
+    if (worker_.joinable())
+        return;
+    if (!hash_built_) {
+        hash_.build();
+        hash_built_ = true;
+    }
+    stop_ = false;
+    start_ = steady_clock::now() - duration_cast<steady_clock::duration>(duration<double>(steps_ * STEP));
+    worker_ = std::thread(&ScentManager::work, this);
+}
+
+void ScentManager::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    stop_cv_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+}
+
+void ScentManager::update(float dt) {
+    if (!hash_built_) {
+        hash_.build();
+        hash_built_ = true;
+    }
+    accumulator_ += dt;
+    int steps = 0;
+    while (accumulator_ >= STEP && steps < MAX_STEPS) {
+        step();
+        accumulator_ -= STEP;
+        steps++;
+    }
+    if (steps == MAX_STEPS)
+        accumulator_ = 0.0f;
+    if (steps > 0)
+        publish();
+}
+
+void ScentManager::findVisible(const glm::vec3 &camera, std::vector<Visible> *visible,
+                               std::vector<uint32_t> *stamps, uint32_t *stamp) const {
+    visible->clear();
+    stamps->resize(sources_.size(), 0);
+    /* a source spanning several cells comes up more than once */
+    if (++*stamp == 0) {
+        std::fill(stamps->begin(), stamps->end(), 0);
+        *stamp = 1;
+    }
+    const float cull = lod_.cull_distance;
+    const glm::vec2 center(camera.x, camera.z);
+    hash_.query(center - cull, center + cull, [&](uint32_t id) {
+        if ((*stamps)[id] == *stamp)
+            return;
+        (*stamps)[id] = *stamp;
+
+        /* distance to the closest point of the track */
+        const Source &source = sources_[id];
+        float along = glm::clamp(glm::dot(camera - source.position, source.direction), 0.0f, float(source.length - 1));
+        float distance = glm::distance(camera, source.position + source.direction * along);
+        if (distance > cull)
+            return;
+        Visible v;
+        v.source = id;
+        v.level = 0;
+        v.fade = 1.0f;
+        if (distance > lod_.near_distance) {
+            v.level = std::min(int(std::log2(distance / lod_.near_distance)) + 1, lod_.max_level);
+            v.fade = 1.0f - (distance - lod_.near_distance) / (cull - lod_.near_distance);
+        }
+        visible->push_back(v);
+    });
+    /* the hash visits in bucket order, keep the simulation independent of it */
+    std::sort(visible->begin(), visible->end(), [](const Visible &a, const Visible &b) { return a.source < b.source; });
+}
+
+void ScentManager::step() {
+    Philox::Counter r = scentRandom(seed_, NO_SOURCE, steps_, 0, WIND_STREAM);
+    wind_ += glm::vec3(Philox::uniform(r[0]) * 0.2f - 0.1f, 0, Philox::uniform(r[1]) * 0.2f - 0.1f) * STEP;
+
+    /* particles leaving the pool give their budget back */
+    size_t head = particles_.slot(0);
+    wind_field_.mean_ = wind_ * 4.0f;
+    wind_field_.advance(STEP);
+    size_t expired = particles_.update(wind_field_, STEP);
+    for (size_t i = 0; i < expired; ++i)
+        live_[particles_.tag_[(head + i) % particles_.capacity()]]--;
+
+    if (field_) {
+        for (size_t s = 0; s < sources_.size(); ++s) {
+            float amount = sources_[s].strength * STEP;
+            for (uint32_t e = emitter_begin_[s]; e < emitter_begin_[s + 1]; ++e)
+                field_->inject(emitters_[e], amount);
+        }
+        field_->setWind(wind_ * 4.0f);
+        field_->step(STEP);
+        if (emitter_in_field_.size() != emitters_.size()) {
+            emitter_in_field_.resize(emitters_.size());
+            for (size_t e = 0; e < emitters_.size(); ++e)
+                emitter_in_field_[e] = field_->contains(emitters_[e]);
+        }
+        emitter_concentration_.resize(emitters_.size());
+        field_->sample(emitters_.data(), emitters_.size(), emitter_concentration_.data(), nullptr);
+    }
+
+    glm::vec3 camera;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        camera = camera_;
+    }
+    findVisible(camera, &step_visible_, &step_stamps_, &step_stamp_);
+
+    /* which markers emit this tick: every draw has its own counter, so the
+       sources can be split over threads and the result stays bit for bit
+       the same */
+    emit_flags_.resize(emitters_.size());
+    const long long visible = (long long)step_visible_.size();
+#pragma omp parallel for schedule(dynamic, 16) if (step_visible_.size() >= PARALLEL_SOURCES)
+    for (long long i = 0; i < visible; ++i) {
+        const Visible &v = step_visible_[i];
+        const Source &source = sources_[v.source];
+        /* the markers left emit for the skipped ones */
+        const uint32_t stride = 1u << v.level, begin = emitter_begin_[v.source], end = emitter_begin_[v.source + 1];
+        const float scale = float(stride) * v.fade * STEP;
+        for (uint32_t e = begin; e < end; e += stride) {
+            float rate = field_ && emitter_in_field_[e] ? SCENT_EMISSION * emitter_concentration_[e]
+                                                        : SCENT_RATE * source.strength;
+            Philox::Counter r = scentRandom(seed_, v.source, steps_, e - begin, EMIT_STREAM);
+            emit_flags_[e] = Philox::uniform(r[0]) < 1.0f - std::exp(-rate * scale);
+        }
+    }
+
+    /* emit in source order, the pool and the budgets are shared */
+    for (const Visible &v : step_visible_) {
+        const Source &source = sources_[v.source];
+        for (uint32_t e = emitter_begin_[v.source]; e < emitter_begin_[v.source + 1]; e += 1u << v.level) {
+            if (!emit_flags_[e])
+                continue;
+            if (live_[v.source] >= source.budget)
+                break;
+            /* a full pool drops its oldest particle */
+            if (particles_.size() == particles_.capacity())
+                live_[particles_.tag_[particles_.slot(0)]]--;
+            particles_.emit(emitters_[e] + wind_, glm::vec3(0.0f), 1.0f, v.source);
+            live_[v.source]++;
+        }
+    }
+    steps_++;
+}
+
+void ScentManager::publish() {
+    if (field_)
+        field_->publish();
+    back_.time = steps_ * double(STEP);
+    back_.first_id = particles_.firstId();
+    back_.particles.resize(particles_.size());
+    back_.sources.resize(particles_.size());
+    for (size_t i = 0; i < particles_.size(); i++) {
+        size_t s = particles_.slot(i);
+        back_.particles[i] = glm::vec4(particles_.position(s), particles_.intensity_[s]);
+        back_.sources[i] = particles_.tag_[s];
+    }
+
+    /* rotate back -> current -> previous, the old previous is reused next time */
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(previous_, current_);
+    std::swap(current_, back_);
+}
+
+void ScentManager::work() {
+    steady_clock::time_point last = steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_cv_.wait_for(lock, duration<float>(STEP), [this] { return stop_; })) {
+        lock.unlock();
+        steady_clock::time_point now = steady_clock::now();
+        update(duration<float>(now - last).count());
+        last = now;
+        lock.lock();
+    }
+}
+
+void ScentManager::render(const glm::vec3 &camera_pos, const glm::mat4 &view, const glm::mat4 &projection) {
+    const float size = 0.1f;
+    batch_.clear();
+
+    /* markers of the sources in range, thinned out with distance */
+    if (hash_built_) {
+        findVisible(camera_pos, &visible_, &render_stamps_, &render_stamp_);
+        for (const Visible &v : visible_) {
+            glm::vec4 color = kindColor(sources_[v.source].kind);
+            for (uint32_t e = emitter_begin_[v.source]; e < emitter_begin_[v.source + 1]; e += 1 << v.level)
+                batch_.add(emitters_[e] - EMITTER_RISE, size, color);
+        }
+    }
+
+    /* floating scent, one publish behind the simulation: a batch may hold
+       up to MAX_STEPS steps, so blend between the two snapshots by their
+       own times, shown that much later than they were simulated */
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        camera_ = camera_pos;
+        double time = current_.time;
+        if (worker_.joinable())
+            time = duration<double>(steady_clock::now() - start_).count();
+        double span = current_.time - previous_.time;
+        float alpha = span > 0.0 ? glm::clamp(float((time - span - previous_.time) / span), 0.0f, 1.0f) : 1.0f;
+
+        const float cull2 = lod_.cull_distance * lod_.cull_distance;
+        for (size_t i = 0; i < current_.particles.size(); i++) {
+            glm::vec4 particle = current_.particles[i];
+            uint64_t id = current_.first_id + i;
+            if (id >= previous_.first_id && id - previous_.first_id < previous_.particles.size())
+                particle = glm::mix(previous_.particles[id - previous_.first_id], particle, alpha);
+            glm::vec3 offset = glm::vec3(particle) - camera_pos;
+            if (glm::dot(offset, offset) > cull2)
+                continue;
+            /* the phase follows the particle, not its place in the snapshot */
+            float phase = float(id % 4096);
+            glm::vec3 position = glm::vec3(particle) + glm::vec3(0, 0.5 * std::sin(time * 2.0f + phase), 0);
+            glm::vec4 color = kindColor(sources_[current_.sources[i]].kind);
+            batch_.add(position, size, glm::vec4(glm::vec3(color), particle.w));
+        }
+    }
+    batch_.sort(view);
+    batch_.render(shader_, view, projection);
+}
@@ -0,0 +1,156 @@
+#include "litewq/scent/ScentOIT.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLErrorHandle.h"
+#include "litewq/utils/logging.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+using namespace litewq;
+
+void ScentOIT::initGL(int width, int height) {
+    width_ = width;
+    height_ = height;
+    /* the composite pass generates its triangle from gl_VertexID */
+    glGenVertexArrays(1, &VAO_);
+    createTargets();
+}
+
+void ScentOIT::finishGL() {
+    deleteTargets();
+    glDeleteVertexArrays(1, &VAO_);
+}
+
+void ScentOIT::resize(int width, int height) {
+    if (width == width_ && height == height_)
+        return;
+    width_ = width;
+    height_ = height;
+    deleteTargets();
+    createTargets();
+}
+
+void ScentOIT::setResolution(int divisor) {
+    CHECK(divisor == 1 || divisor == 2 || divisor == 4) << "Invalid scent resolution divisor: " << divisor;
+#ifdef LITEWQ_GLES
+    /* ES 3.0 only blits depth between rectangles of the same size */
+    divisor = 1;
+#endif
+    if (divisor == divisor_)
+        return;
+    divisor_ = divisor;
+    if (FBO_) {
+        deleteTargets();
+        createTargets();
+    }
+}
+
+void ScentOIT::createTargets() {
+    low_width_ = std::max(width_ / divisor_, 1);
+    low_height_ = std::max(height_ / divisor_, 1);
+    auto createTarget = [](unsigned int *tex, int width, int height, GLint format, GLenum channels, GLenum type) {
+        glGenTextures(1, tex);
+        glBindTexture(GL_TEXTURE_2D, *tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, channels, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    };
+    createTarget(&accum_tex_, low_width_, low_height_, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+    createTarget(&reveal_tex_, low_width_, low_height_, GL_R16F, GL_RED, GL_HALF_FLOAT);
+    /* same format as the default framebuffer, depth is blitted in */
+    createTarget(&depth_tex_, low_width_, low_height_, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL,
+                 GL_UNSIGNED_INT_24_8);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &FBO_);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accum_tex_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, reveal_tex_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_tex_, 0);
+    const GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, buffers);
+    CHECK_EQ(glCheckFramebufferStatus(GL_FRAMEBUFFER), GL_FRAMEBUFFER_COMPLETE) << "Incomplete scent OIT framebuffer";
+
+    if (divisor_ > 1) {
+        createTarget(&scene_depth_tex_, width_, height_, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL,
+                     GL_UNSIGNED_INT_24_8);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &scene_depth_FBO_);
+        glBindFramebuffer(GL_FRAMEBUFFER, scene_depth_FBO_);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, scene_depth_tex_, 0);
+        const GLenum none = GL_NONE;
+        glDrawBuffers(1, &none);
+        glReadBuffer(GL_NONE);
+        CHECK_EQ(glCheckFramebufferStatus(GL_FRAMEBUFFER), GL_FRAMEBUFFER_COMPLETE)
+            << "Incomplete scent depth framebuffer";
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ScentOIT::deleteTargets() {
+    glDeleteFramebuffers(1, &FBO_);
+    glDeleteTextures(1, &accum_tex_);
+    glDeleteTextures(1, &reveal_tex_);
+    glDeleteTextures(1, &depth_tex_);
+    glDeleteFramebuffers(1, &scene_depth_FBO_);
+    glDeleteTextures(1, &scene_depth_tex_);
+    FBO_ = scene_depth_FBO_ = scene_depth_tex_ = 0;
+}
+
+void ScentOIT::begin(unsigned int target) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+    if (divisor_ > 1) {
+        /* keep the full depth for the upsample, the sprites test against
+           every divisor-th texel of it */
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scene_depth_FBO_);
+        GL_CHECK(glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_DEPTH_BUFFER_BIT, GL_NEAREST));
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_depth_FBO_);
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO_);
+    GL_CHECK(glBlitFramebuffer(0, 0, width_, height_, 0, 0, low_width_, low_height_, GL_DEPTH_BUFFER_BIT,
+                               GL_NEAREST));
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO_);
+    glViewport(0, 0, low_width_, low_height_);
+
+    const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, zero);
+    /* the sprite renderers enable blending and disable depth writes */
+    glBlendFunc(GL_ONE, GL_ONE);
+}
+
+void ScentOIT::end(unsigned int target) {
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(0, 0, width_, height_);
+
+    composite_shader_.Bind();
+    composite_shader_.updateUniformInt("accumulation", 0);
+    composite_shader_.updateUniformInt("revealage", 1);
+    composite_shader_.updateUniformInt("divisor", divisor_);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, accum_tex_);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, reveal_tex_);
+    if (divisor_ > 1) {
+        composite_shader_.updateUniformInt("lowDepth", 2);
+        composite_shader_.updateUniformInt("sceneDepth", 3);
+        composite_shader_.updateUniformFloat2("depthRange", glm::vec2(z_near_, z_far_));
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, depth_tex_);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, scene_depth_tex_);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBindVertexArray(VAO_);
+    GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 3));
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,75 @@
+#include "litewq/scent/ScentParticles.h"
+#include "litewq/scent/WindField.h"
+#include "litewq/utils/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace litewq;
+
+/* below this many particles threads cost more than they save */
+static constexpr size_t PARALLEL_PARTICLES = 16384;
+
+ScentParticles::ScentParticles(size_t capacity, float lifetime, float decay)
+    : x_(capacity), y_(capacity), z_(capacity),
+      vx_(capacity), vy_(capacity), vz_(capacity),
+      age_(capacity), intensity_(capacity), tag_(capacity),
+      wind_x_(capacity), wind_y_(capacity), wind_z_(capacity),
+      lifetime_(lifetime), decay_(decay) {
+    CHECK(capacity > 0) << "Invalid scent particle budget: " << capacity;
+}
+
+void ScentParticles::emit(const glm::vec3 &position, const glm::vec3 &velocity, float intensity, uint32_t tag) {
+    size_t s;
+    if (size_ == capacity()) {
+        /* full: overwrite the oldest */
+        s = head_;
+        head_ = slot(1);
+    } else {
+        s = slot(size_++);
+    }
+    ++emitted_;
+    x_[s] = position.x;
+    y_[s] = position.y;
+    z_[s] = position.z;
+    vx_[s] = velocity.x;
+    vy_[s] = velocity.y;
+    vz_[s] = velocity.z;
+    age_[s] = 0.0f;
+    intensity_[s] = intensity;
+    tag_[s] = tag;
+}
+
+size_t ScentParticles::update(const WindField &wind, float dt) {
+    const float fade = std::exp(-decay_ * dt);
+    /* the live slots wrap around at most once */
+    size_t end = head_ + size_;
+    advance(head_, std::min(end, capacity()), wind, dt, fade);
+    if (end > capacity())
+        advance(0, end - capacity(), wind, dt, fade);
+
+    size_t expired = 0;
+    while (size_ > 0 && age_[head_] >= lifetime_) {
+        head_ = slot(1);
+        --size_;
+        ++expired;
+    }
+    return expired;
+}
+
+void ScentParticles::advance(size_t begin, size_t end, const WindField &wind, float dt, float fade) {
+    float *x = x_.data(), *y = y_.data(), *z = z_.data();
+    const float *vx = vx_.data(), *vy = vy_.data(), *vz = vz_.data();
+    float *age = age_.data(), *intensity = intensity_.data();
+    float *wx = wind_x_.data(), *wy = wind_y_.data(), *wz = wind_z_.data();
+    wind.velocity(x + begin, y + begin, z + begin, wx + begin, wy + begin, wz + begin, end - begin);
+    const long long b = (long long)begin, e = (long long)end;
+#pragma omp parallel for simd schedule(static) if (end - begin >= PARALLEL_PARTICLES)
+    for (long long i = b; i < e; ++i) {
+        x[i] += (vx[i] + wx[i]) * dt;
+        y[i] += (vy[i] + wy[i]) * dt;
+        z[i] += (vz[i] + wz[i]) * dt;
+        age[i] += dt;
+        intensity[i] *= fade;
+    }
+}
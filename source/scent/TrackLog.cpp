@@ -0,0 +1,243 @@
+#include "litewq/scent/TrackLog.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLErrorHandle.h"
+#include "litewq/utils/logging.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+using namespace litewq;
+
+static_assert(sizeof(TrackLog::Sample) == 20, "Track samples are uploaded as they are");
+
+TrackLog::TrackLog(const Config &config) : config_(config) {
+    CHECK(config.spacing > 0.0f && config.decimate_age > 0.0f && config.max_age > 0.0f &&
+          config.cell_size > 0.0f) << "Invalid track log config";
+    const glm::vec4 palette[MAX_SPECIES] = {
+        {0.55f, 0.35f, 0.20f, 0.9f}, {0.85f, 0.75f, 0.55f, 0.9f}, {0.35f, 0.35f, 0.40f, 0.9f},
+        {0.80f, 0.30f, 0.15f, 0.9f}, {0.30f, 0.50f, 0.25f, 0.9f}, {0.60f, 0.55f, 0.70f, 0.9f},
+        {0.90f, 0.90f, 0.90f, 0.9f}, {0.20f, 0.20f, 0.20f, 0.9f},
+    };
+    std::copy(palette, palette + MAX_SPECIES, species_color_);
+}
+
+bool TrackLog::append(uint16_t animal, uint8_t species, const glm::vec3 &position, float time) {
+    if (animal >= last_position_.size())
+        last_position_.resize(animal + 1, glm::vec3(0.0f, std::numeric_limits<float>::quiet_NaN(), 0.0f));
+    glm::vec3 &last = last_position_[animal];
+    glm::vec3 step = position - last;
+    if (!std::isnan(last.y) && glm::dot(step, step) < config_.spacing * config_.spacing)
+        return false;
+    last = position;
+
+    const glm::ivec2 coord = this->cell(position.x, position.z);
+    cell_lo_ = glm::min(cell_lo_, coord);
+    cell_hi_ = glm::max(cell_hi_, coord);
+    Cell &cell = cells_[key(coord)];
+    /* thinned chunks are closed, new samples start a fresh one */
+    if (cell.chunks.empty() || cell.chunks.back().samples.size() == CHUNK_SAMPLES || cell.chunks.back().level > 0) {
+        cell.chunks.emplace_back();
+        cell.chunks.back().samples.reserve(CHUNK_SAMPLES);
+    }
+    Chunk &chunk = cell.chunks.back();
+    CHECK(time >= chunk.last_time) << "Track samples out of time order: " << time;
+    chunk.samples.push_back({position, time, animal, species, 0});
+    chunk.last_time = time;
+    cell.bounds = Union(cell.bounds, position);
+    ++size_;
+    return true;
+}
+
+void TrackLog::update(float now) {
+    cell_lo_ = glm::ivec2(std::numeric_limits<int>::max());
+    cell_hi_ = glm::ivec2(std::numeric_limits<int>::min());
+    for (auto it = cells_.begin(); it != cells_.end();) {
+        std::deque<Chunk> &chunks = it->second.chunks;
+        while (!chunks.empty() && chunks.front().last_time < now - config_.max_age) {
+            size_ -= chunks.front().samples.size();
+            chunks.pop_front();
+        }
+        if (chunks.empty()) {
+            it = cells_.erase(it);
+            continue;
+        }
+        /* a cell walked through rarely keeps a chunk open for long */
+        std::vector<Sample> &front = chunks.front().samples;
+        auto expired = std::find_if(front.begin(), front.end(),
+                                    [&](const Sample &sample) { return sample.time >= now - config_.max_age; });
+        size_ -= expired - front.begin();
+        front.erase(front.begin(), expired);
+
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            Chunk &chunk = chunks[i];
+            if (chunk.level >= config_.max_level ||
+                now - chunk.last_time < config_.decimate_age * float(1 << chunk.level))
+                continue;
+            decimate(&chunk);
+
+            /* neighbours thinned as often share a chunk again */
+            if (i == 0)
+                continue;
+            Chunk &previous = chunks[i - 1];
+            if (previous.level != chunk.level || previous.samples.size() + chunk.samples.size() > CHUNK_SAMPLES)
+                continue;
+            previous.samples.insert(previous.samples.end(), chunk.samples.begin(), chunk.samples.end());
+            previous.last_time = chunk.last_time;
+            chunks.erase(chunks.begin() + i);
+            --i;
+        }
+        /* dropped and decimated samples may have held the bounds out */
+        updateBounds(&it->second);
+        const glm::ivec2 coord = cell(it->second.bounds.pMin.x, it->second.bounds.pMin.z);
+        cell_lo_ = glm::min(cell_lo_, coord);
+        cell_hi_ = glm::max(cell_hi_, coord);
+        ++it;
+    }
+}
+
+void TrackLog::updateBounds(Cell *cell) {
+    cell->bounds = Bounds3();
+    for (const Chunk &chunk : cell->chunks)
+        for (const Sample &sample : chunk.samples)
+            cell->bounds = Union(cell->bounds, sample.position);
+}
+
+void TrackLog::clear() {
+    cells_.clear();
+    cell_lo_ = glm::ivec2(std::numeric_limits<int>::max());
+    cell_hi_ = glm::ivec2(std::numeric_limits<int>::min());
+    last_position_.clear();
+    size_ = 0;
+}
+
+void TrackLog::decimate(Chunk *chunk) {
+    /* keep every other sample of each animal, its first one included */
+    parity_.assign(last_position_.size(), 0);
+    size_t kept = 0;
+    for (const Sample &sample : chunk->samples) {
+        if (parity_[sample.animal]++ & 1)
+            continue;
+        Sample &out = chunk->samples[kept++];
+        out = sample;
+        out.level++;
+    }
+    size_ -= chunk->samples.size() - kept;
+    chunk->samples.resize(kept);
+    chunk->level++;
+}
+
+bool TrackLog::nearest(const glm::vec3 &position, float radius, float now, float max_age, int species,
+                       Sample *found) const {
+    const glm::ivec2 lo = cell(position.x - radius, position.z - radius),
+                     hi = cell(position.x + radius, position.z + radius);
+    const float oldest = now - max_age;
+    float best = radius * radius;
+    bool hit = false;
+    for (int x = lo.x; x <= hi.x; ++x)
+        for (int z = lo.y; z <= hi.y; ++z) {
+            auto it = cells_.find(key(glm::ivec2(x, z)));
+            if (it == cells_.end())
+                continue;
+            forChunks(it->second, oldest, [&](const Chunk &chunk) {
+                for (const Sample &sample : chunk.samples) {
+                    if (sample.time < oldest || (species != ANY_SPECIES && sample.species != species))
+                        continue;
+                    float dx = sample.position.x - position.x, dz = sample.position.z - position.z;
+                    float distance2 = dx * dx + dz * dz;
+                    if (distance2 < best) {
+                        best = distance2;
+                        *found = sample;
+                        hit = true;
+                    }
+                }
+            });
+        }
+    return hit;
+}
+
+void TrackLog::visible(const Frustum &frustum, float now, float max_age, std::vector<Sample> *found) const {
+    const float oldest = now - max_age;
+    /* the cells under the frustum, clipped to the occupied ones */
+    const glm::ivec2 lo = glm::max(cell(frustum.bounds.pMin.x, frustum.bounds.pMin.z), cell_lo_),
+                     hi = glm::min(cell(frustum.bounds.pMax.x, frustum.bounds.pMax.z), cell_hi_);
+    for (int x = lo.x; x <= hi.x; ++x)
+        for (int z = lo.y; z <= hi.y; ++z) {
+            auto it = cells_.find(key(glm::ivec2(x, z)));
+            if (it == cells_.end())
+                continue;
+            const Cell &cell = it->second;
+            if (cell.chunks.back().last_time < oldest || !frustum.intersect(cell.bounds))
+                continue;
+            forChunks(cell, oldest, [&](const Chunk &chunk) {
+                for (const Sample &sample : chunk.samples)
+                    if (sample.time >= oldest && frustum.contains(sample.position))
+                        found->push_back(sample);
+            });
+        }
+}
+
+void TrackLog::initGL() {
+    /* quad corners, drawn as a triangle strip */
+    const glm::vec2 corners[4] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {-1.0f, 1.0f}, {1.0f, 1.0f}};
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quad_VBO);
+    glGenBuffers(1, &instance_VBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
+
+    /* the samples as they are: position and time, species */
+    glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Sample), (void *)offsetof(Sample, position));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, sizeof(Sample), (void *)offsetof(Sample, species));
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+}
+
+void TrackLog::finishGL() {
+    glDeleteBuffers(1, &quad_VBO);
+    glDeleteBuffers(1, &instance_VBO);
+    glDeleteVertexArrays(1, &VAO);
+    capacity_ = 0;
+}
+
+void TrackLog::render(GLShader &shader, const Frustum &frustum, float now, const glm::mat4 &view,
+                      const glm::mat4 &projection) {
+    markers_.clear();
+    visible(frustum, now, config_.max_age, &markers_);
+    if (markers_.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+    /* orphan the old storage instead of waiting for draws still reading it */
+    capacity_ = std::max(capacity_, markers_.size());
+    glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(Sample), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, markers_.size() * sizeof(Sample), markers_.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    shader.Bind();
+    shader.updateUniformMat4("view", view);
+    shader.updateUniformMat4("projection", projection);
+    shader.updateUniformFloat("now", now);
+    shader.updateUniformFloat("maxAge", config_.max_age);
+    shader.updateUniformFloat("size", marker_size_);
+    for (int i = 0; i < MAX_SPECIES; ++i)
+        shader.updateUniformFloat4("speciesColor[" + std::to_string(i) + "]", species_color_[i]);
+    glEnable(GL_BLEND);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(VAO);
+    GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(markers_.size())));
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
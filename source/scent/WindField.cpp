@@ -0,0 +1,188 @@
+#include "litewq/scent/WindField.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/terrain/Terrain.h"
+#include "litewq/utils/logging.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace litewq;
+
+/* points evaluated together, the terrain heights of a block stay on the stack */
+static constexpr size_t BLOCK = 256;
+/* below this many points threads cost more than they save */
+static constexpr size_t PARALLEL_POINTS = 16384;
+static constexpr uint32_t MASK = WindField::PERIOD - 1;
+
+/* same hash as update_vertex.glsl */
+static inline uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline float fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static inline float fadeDerivative(float t) {
+    return 30.0f * t * t * (t - 1.0f) * (t - 1.0f);
+}
+
+/* floor without the libm call or a branch, so the loops vectorize */
+static inline int floorInt(float x) {
+    int i = int(x);
+    return i - int(float(i) > x);
+}
+
+/* clamp to [0, 1] with abs instead of compares, which are kept in order
+   (they may trap) and stop the loops from vectorizing */
+static inline float saturate(float t) {
+    t = 0.5f * (t + std::abs(t));
+    return t - 0.5f * (t - 1.0f + std::abs(t - 1.0f));
+}
+
+/* Gradient of the noise component at the lattice point (i, j, k), from a
+ * hash of the wrapped point, so the noise tiles every PERIOD cells. */
+static inline void latticeGradient(int i, int j, int k, uint32_t component, float *gx, float *gy, float *gz) {
+    uint32_t point = (uint32_t(i) & MASK) +
+                     WindField::PERIOD * ((uint32_t(j) & MASK) +
+                                          WindField::PERIOD * ((uint32_t(k) & MASK) + WindField::PERIOD * component));
+    uint32_t h = hash(point);
+    *gx = float(h & 1023u) * (2.0f / 1023.0f) - 1.0f;
+    *gy = float((h >> 10) & 1023u) * (2.0f / 1023.0f) - 1.0f;
+    *gz = float((h >> 20) & 1023u) * (2.0f / 1023.0f) - 1.0f;
+}
+
+WindField::WindField(float scale, float strength) : scale_(scale), strength_(strength) {
+    CHECK(scale > 0.0f) << "Invalid wind noise scale: " << scale;
+}
+
+void WindField::advance(float dt) {
+    offset_ += mean_ * dt;
+}
+
+glm::vec3 WindField::velocity(const glm::vec3 &position) const {
+    glm::vec3 v;
+    velocity(&position.x, &position.y, &position.z, &v.x, &v.y, &v.z, 1);
+    return v;
+}
+
+void WindField::velocity(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                         size_t count) const {
+    const long long blocks = (long long)((count + BLOCK - 1) / BLOCK);
+#pragma omp parallel for schedule(static) if (count >= PARALLEL_POINTS)
+    for (long long b = 0; b < blocks; ++b) {
+        size_t begin = size_t(b) * BLOCK, n = std::min(BLOCK, count - begin);
+        curl(x + begin, y + begin, z + begin, vx + begin, vy + begin, vz + begin, n);
+        if (terrain_)
+            deflect(x + begin, y + begin, z + begin, vx + begin, vy + begin, vz + begin, n);
+    }
+}
+
+void WindField::curl(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                     size_t count) const {
+    /* lattice cell, position in it and the fade weights of every point */
+    int cell_x[BLOCK], cell_y[BLOCK], cell_z[BLOCK];
+    float fx[BLOCK], fy[BLOCK], fz[BLOCK];
+    float ux[BLOCK], uy[BLOCK], uz[BLOCK], dux[BLOCK], duy[BLOCK], duz[BLOCK];
+    /* gradient of each potential component, axis by axis */
+    float gradient[3][3][BLOCK];
+    const float inv_scale = 1.0f / scale_;
+    const glm::vec3 offset = offset_;
+#pragma omp simd
+    for (size_t n = 0; n < count; ++n) {
+        float px = (x[n] - offset.x) * inv_scale, py = (y[n] - offset.y) * inv_scale,
+              pz = (z[n] - offset.z) * inv_scale;
+        cell_x[n] = floorInt(px);
+        cell_y[n] = floorInt(py);
+        cell_z[n] = floorInt(pz);
+        fx[n] = px - float(cell_x[n]);
+        fy[n] = py - float(cell_y[n]);
+        fz[n] = pz - float(cell_z[n]);
+        ux[n] = fade(fx[n]);
+        uy[n] = fade(fy[n]);
+        uz[n] = fade(fz[n]);
+        dux[n] = fadeDerivative(fx[n]);
+        duy[n] = fadeDerivative(fy[n]);
+        duz[n] = fadeDerivative(fz[n]);
+    }
+
+    /* one corner of the cell at a time over the whole block: the noise is the
+       corner values weighted by the fades, its gradient the weighted corner
+       gradients plus the change of the weights */
+    for (uint32_t component = 0; component < 3; ++component) {
+        float *gradient_x = gradient[component][0], *gradient_y = gradient[component][1],
+              *gradient_z = gradient[component][2];
+        std::fill(gradient_x, gradient_x + count, 0.0f);
+        std::fill(gradient_y, gradient_y + count, 0.0f);
+        std::fill(gradient_z, gradient_z + count, 0.0f);
+        for (int corner = 0; corner < 8; ++corner) {
+            const int a = corner & 1, b = (corner >> 1) & 1, c = corner >> 2;
+            /* the weight is u on the far side and 1 - u on the near side */
+            const float sign_x = a ? 1.0f : -1.0f, sign_y = b ? 1.0f : -1.0f, sign_z = c ? 1.0f : -1.0f;
+#pragma omp simd
+            for (size_t n = 0; n < count; ++n) {
+                float gx, gy, gz;
+                latticeGradient(cell_x[n] + a, cell_y[n] + b, cell_z[n] + c, component, &gx, &gy, &gz);
+                float value = gx * (fx[n] - a) + gy * (fy[n] - b) + gz * (fz[n] - c);
+                float wx = float(1 - a) + sign_x * ux[n], wy = float(1 - b) + sign_y * uy[n],
+                      wz = float(1 - c) + sign_z * uz[n];
+                float w = wx * wy * wz;
+                gradient_x[n] += w * gx + sign_x * dux[n] * wy * wz * value;
+                gradient_y[n] += w * gy + sign_y * duy[n] * wx * wz * value;
+                gradient_z[n] += w * gz + sign_z * duz[n] * wx * wy * value;
+            }
+        }
+    }
+
+    /* velocity = curl of the potential (A, B, C) */
+    const float strength = strength_;
+    const glm::vec3 mean = mean_;
+    float(*A)[BLOCK] = gradient[0], (*B)[BLOCK] = gradient[1], (*C)[BLOCK] = gradient[2];
+#pragma omp simd
+    for (size_t n = 0; n < count; ++n) {
+        vx[n] = mean.x + strength * (C[1][n] - B[2][n]);
+        vy[n] = mean.y + strength * (A[2][n] - C[0][n]);
+        vz[n] = mean.z + strength * (B[0][n] - A[1][n]);
+    }
+}
+
+void WindField::deflect(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                        size_t count) const {
+    float heights[BLOCK], dhdx[BLOCK], dhdz[BLOCK];
+    terrain_->heightField().slopeAt(x, z, heights, dhdx, dhdz, count);
+    const float inv_boundary = 1.0f / boundary_height_;
+#pragma omp simd
+    for (size_t n = 0; n < count; ++n) {
+        /* on the ground the wind runs along the slope, above the boundary
+           layer it is left alone */
+        float t = saturate((y[n] - heights[n]) * inv_boundary);
+        float along_slope = vx[n] * dhdx[n] + vz[n] * dhdz[n];
+        vy[n] += (1.0f - t) * (1.0f - t) * (along_slope - vy[n]);
+    }
+}
+
+void WindField::setUniforms(GLShader &shader, unsigned int unit) const {
+    shader.updateUniformFloat3("windMean", mean_);
+    shader.updateUniformFloat3("windOffset", offset_);
+    shader.updateUniformFloat("windScale", scale_);
+    shader.updateUniformFloat("windStrength", strength_);
+    shader.updateUniformFloat("windBoundary", boundary_height_);
+    shader.updateUniformInt("windTerrain", terrain_ != nullptr);
+    shader.updateUniformInt("windHeightMap", int(unit));
+    if (terrain_) {
+        const HeightField &height_field = terrain_->heightField();
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, terrain_->heightTexture());
+        glActiveTexture(GL_TEXTURE0);
+        shader.updateUniformFloat2("windHeightMapSize", glm::vec2(height_field.cols_, height_field.rows_));
+        shader.updateUniformFloat2("windHeightRange",
+                                   glm::vec2(255.0f * height_field.height_scale_, height_field.height_offset_));
+    }
+}
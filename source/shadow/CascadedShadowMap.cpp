@@ -0,0 +1,223 @@
+#include "litewq/shadow/CascadedShadowMap.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLErrorHandle.h"
+#include "litewq/utils/logging.h"
+
+#include "glad/glad.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+using namespace litewq;
+
+CascadedShadowMap::CascadedShadowMap(const ShadowConfig &config) : config_(config) {
+    CHECK(config_.cascades >= 1 && config_.cascades <= MAX_CASCADES)
+        << "Unsupported cascade count: " << config_.cascades;
+    CHECK(config_.pcf_taps == 1 || config_.pcf_taps == 4 || config_.pcf_taps == 9)
+        << "Unsupported PCF tap count: " << config_.pcf_taps;
+    for (int c = 0; c < MAX_CASCADES; ++c) {
+        light_matrices_[c] = glm::mat4(1.0f);
+        splits_[c] = 0.0f;
+        texel_size_[c] = depth_range_[c] = 1.0f;
+        cached_[c] = refresh_[c] = composited_[c] = false;
+        cached_radius_[c] = 0.0f;
+    }
+}
+
+/* compared arrays are sampled with sampler2DArrayShadow, linear filtering
+ * then blends the four comparisons of a 2x2 footprint */
+static unsigned int createDepthArray(int resolution, int layers, bool compared) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    GL_CHECK(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution,
+                          layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr));
+    GLint filter = compared ? GL_LINEAR : GL_NEAREST;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+    if (compared) {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+    /* nothing is in shadow outside the cascade */
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glm::vec4 border(1.0f);
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, glm::value_ptr(border));
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texture;
+}
+
+void CascadedShadowMap::initGL() {
+    depth_tex_ = createDepthArray(config_.resolution, config_.cascades, true);
+    static_tex_ = createDepthArray(config_.resolution, config_.cascades, false);
+
+    glGenFramebuffers(1, &FBO);
+    glGenFramebuffers(1, &copy_FBO);
+    for (unsigned int fbo : {FBO, copy_FBO}) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth_tex_, 0, 0);
+        const GLenum none = GL_NONE;
+        glDrawBuffers(1, &none);
+        glReadBuffer(GL_NONE);
+        CHECK(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+            << "Shadow map framebuffer is incomplete";
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CascadedShadowMap::finishGL() {
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteFramebuffers(1, &copy_FBO);
+    glDeleteTextures(1, &depth_tex_);
+    glDeleteTextures(1, &static_tex_);
+    FBO = copy_FBO = depth_tex_ = static_tex_ = 0;
+}
+
+void CascadedShadowMap::update(const glm::mat4 &view, const glm::mat4 &projection, float z_near, float z_far,
+                               const glm::vec3 &light_dir) {
+    const float shadow_far = std::min(z_far, config_.max_distance);
+
+    /* corners of the full frustum, slices interpolate along its edges */
+    glm::mat4 inv = glm::inverse(projection * view);
+    glm::vec3 near_corners[4], far_corners[4];
+    for (int k = 0; k < 4; ++k) {
+        float x = (k & 1) ? 1.0f : -1.0f, y = (k & 2) ? 1.0f : -1.0f;
+        glm::vec4 n = inv * glm::vec4(x, y, -1.0f, 1.0f);
+        glm::vec4 f = inv * glm::vec4(x, y, 1.0f, 1.0f);
+        near_corners[k] = glm::vec3(n) / n.w;
+        far_corners[k] = glm::vec3(f) / f.w;
+    }
+
+    /* rotation only, so snapping in light space is independent of the camera */
+    glm::vec3 dir = glm::normalize(light_dir);
+    glm::vec3 up = std::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), -dir, up);
+    const float cos_cache_angle = std::cos(glm::radians(config_.cache_angle));
+
+    glm::vec3 centers[MAX_CASCADES];
+    float radii[MAX_CASCADES];
+    bool stale[MAX_CASCADES];
+    float slice_near = z_near;
+    for (int c = 0; c < cascades(); ++c) {
+        /* practical split: blend of logarithmic and uniform */
+        float i = float(c + 1) / float(cascades());
+        float log_split = z_near * std::pow(shadow_far / z_near, i);
+        float uniform_split = z_near + (shadow_far - z_near) * i;
+        float slice_far = config_.split_lambda * log_split + (1.0f - config_.split_lambda) * uniform_split;
+
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        float a = (slice_near - z_near) / (z_far - z_near), b = (slice_far - z_near) / (z_far - z_near);
+        for (int k = 0; k < 4; ++k) {
+            corners[k] = glm::mix(near_corners[k], far_corners[k], a);
+            corners[k + 4] = glm::mix(near_corners[k], far_corners[k], b);
+        }
+        for (const auto &corner : corners)
+            center += corner / 8.0f;
+        float radius = 0.0f;
+        for (const auto &corner : corners)
+            radius = std::max(radius, glm::length(corner - center));
+
+        centers[c] = center;
+        radii[c] = radius;
+        splits_[c] = slice_far;
+        slice_near = slice_far;
+        /* the cached layer must still cover the slice, lit from about the same direction */
+        stale[c] = !cached_[c] || glm::dot(cached_light_dir_[c], dir) < cos_cache_angle ||
+                   glm::length(center - cached_center_[c]) + radius > cached_radius_[c];
+        /* nothing cached yet, there is no older layer to fall back on */
+        refresh_[c] = !cached_[c];
+    }
+
+    refresh_[0] = stale[0];
+    for (int k = 0; k + 1 < cascades(); ++k) {
+        int c = 1 + (next_far_ - 1 + k) % (cascades() - 1);
+        if (stale[c] && !refresh_[c]) {
+            refresh_[c] = true;
+            next_far_ = c + 1 < cascades() ? c + 1 : 1;
+            break;
+        }
+    }
+
+    for (int c = 0; c < cascades(); ++c) {
+        if (refresh_[c]) {
+            fit(c, centers[c], radii[c], light_view);
+            cached_light_dir_[c] = dir;
+        }
+    }
+}
+
+/* Orthographic light projection around a bounding sphere grown by the cache
+ * margin, with its center snapped to whole texels. */
+void CascadedShadowMap::fit(int cascade, const glm::vec3 &center, float radius, const glm::mat4 &light_view) {
+    /* quantized, so float noise does not change the texel size */
+    radius = std::ceil(radius * (1.0f + config_.cache_margin) * 16.0f) / 16.0f;
+    float texel = 2.0f * radius / float(config_.resolution);
+    glm::vec3 light_center = glm::vec3(light_view * glm::vec4(center, 1.0f));
+    light_center.x = std::floor(light_center.x / texel) * texel;
+    light_center.y = std::floor(light_center.y / texel) * texel;
+    glm::mat4 light_projection = glm::ortho(
+        light_center.x - radius, light_center.x + radius,
+        light_center.y - radius, light_center.y + radius,
+        -light_center.z - radius - config_.caster_distance, -light_center.z + radius);
+
+    light_matrices_[cascade] = light_projection * light_view;
+    frusta_[cascade] = Frustum(light_matrices_[cascade]);
+    texel_size_[cascade] = texel;
+    depth_range_[cascade] = 2.0f * radius + config_.caster_distance;
+
+    cached_[cascade] = true;
+    /* snapping moved the center by up to a texel diagonal */
+    cached_center_[cascade] = center;
+    cached_radius_[cascade] = radius - texel * 1.5f;
+}
+
+int CascadedShadowMap::refreshed() const {
+    int count = 0;
+    for (int c = 0; c < cascades(); ++c)
+        count += refresh_[c];
+    return count;
+}
+
+void CascadedShadowMap::bindStatic(int cascade) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, static_tex_, 0, cascade);
+    glViewport(0, 0, config_.resolution, config_.resolution);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+bool CascadedShadowMap::bindDynamic(int cascade, bool has_dynamic) {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth_tex_, 0, cascade);
+    /* the sampled layer already equals the static one otherwise */
+    if (has_dynamic || composited_[cascade] || refresh_[cascade]) {
+        const int size = config_.resolution;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, copy_FBO);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, static_tex_, 0, cascade);
+        glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    }
+    composited_[cascade] = has_dynamic;
+    glViewport(0, 0, config_.resolution, config_.resolution);
+    return has_dynamic;
+}
+
+void CascadedShadowMap::bind(GLShader *shader, unsigned int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depth_tex_);
+    glActiveTexture(GL_TEXTURE0);
+    shader->updateUniformInt("shadowMap", int(unit));
+    shader->updateUniformInt("cascadeCount", cascades());
+    shader->updateUniformInt("shadowTaps", config_.pcf_taps);
+    for (int c = 0; c < cascades(); ++c) {
+        std::string index = "[" + std::to_string(c) + "]";
+        shader->updateUniformMat4("lightSpaceMatrices" + index, light_matrices_[c]);
+        shader->updateUniformFloat("cascadeSplits" + index, splits_[c]);
+        shader->updateUniformFloat("cascadeTexel" + index, texel_size_[c]);
+        shader->updateUniformFloat("cascadeDepthScale" + index, 1.0f / depth_range_[c]);
+    }
+}
@@ -0,0 +1,422 @@
+#include "litewq/terrain/HeightField.h"
+#include "litewq/utils/logging.h"
+
+#include "stb/stb_image.h"
+#include <glm/packing.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+using namespace litewq;
+using namespace std::chrono;
+
+namespace {
+
+constexpr char CACHE_MAGIC[4] = {'L', 'W', 'Q', 'T'};
+constexpr uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t rows, cols;
+    float height_scale, height_offset;
+    /* identity of the source image the cache was built from */
+    uint64_t source_size;
+    int64_t source_time;
+};
+
+} // end anonymous namespace
+
+/* same rounding as glm::packSnorm4x8, written out so the loops vectorize */
+static inline uint32_t packSnorm8(float x) {
+    int v = int(x * 127.0f + (x >= 0.0f ? 0.5f : -0.5f));
+    return uint32_t(v) & 0xff;
+}
+
+static CacheHeader sourceHeader(const std::string &heightmap, int rows, int cols,
+                                float height_scale, float height_offset) {
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.rows = rows;
+    header.cols = cols;
+    header.height_scale = height_scale;
+    header.height_offset = height_offset;
+    std::error_code error;
+    header.source_size = std::filesystem::file_size(heightmap, error);
+    header.source_time = std::filesystem::last_write_time(heightmap, error).time_since_epoch().count();
+    return header;
+}
+
+HeightField::HeightField(const std::string &heightmap, float height_scale, float height_offset)
+    : height_scale_(height_scale), height_offset_(height_offset)
+{
+    std::string cache = heightmap + ".terrain";
+    if (readCache(cache, heightmap)) {
+        buildTiles(0, 0, level_dims_[0].x - 1, level_dims_[0].y - 1);
+        LOG(INFO) << "Load terrain cache: " << cache;
+        return;
+    }
+
+    int channels;
+    stbi_set_flip_vertically_on_load(false);
+    /* 8-bit sources are widened to 16 bits (pixel * 257) */
+    uint16_t *samples = stbi_load_16(heightmap.c_str(), &cols_, &rows_, &channels, 1);
+    CHECK(samples) << "Failed to load heightmap: " << heightmap;
+    CHECK(rows_ >= 2 && cols_ >= 2) << "Heightmap needs at least 2x2 samples: " << heightmap;
+    samples_.assign(samples, samples + rows_ * cols_);
+    stbi_image_free(samples);
+    allocate();
+
+    high_resolution_clock::time_point t0 = high_resolution_clock::now();
+    build(0, 0, rows_ - 1, cols_ - 1);
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    LOG(INFO) << "Preprocessing terrain finished: " << duration<double>(t1 - t0).count() << " s";
+
+    writeCache(cache, heightmap);
+}
+
+void HeightField::allocate() {
+    normals_.resize(samples_.size());
+    tangents_.resize(samples_.size());
+    level_dims_.assign(1, glm::ivec2(rows_ - 1, cols_ - 1));
+    while (level_dims_.back() != glm::ivec2(1, 1))
+        level_dims_.push_back((level_dims_.back() + 1) / 2);
+    pyramid_.resize(level_dims_.size());
+    for (size_t level = 0; level < level_dims_.size(); ++level)
+        pyramid_[level].resize(level_dims_[level].x * level_dims_[level].y);
+}
+
+void HeightField::updateSamples(int row, int col, int rows, int cols, const uint16_t *samples) {
+    CHECK(row >= 0 && col >= 0 && rows >= 0 && cols >= 0 && row + rows <= rows_ && col + cols <= cols_)
+        << "Height update out of the heightmap: " << row << ", " << col << " " << rows << "x" << cols;
+    for (int i = 0; i < rows; ++i)
+        std::copy(samples + i * cols, samples + (i + 1) * cols, &samples_[(row + i) * cols_ + col]);
+    refresh(row, col, row + rows - 1, col + cols - 1);
+}
+
+void HeightField::refresh(int row0, int col0, int row1, int col1) {
+    build(std::max(row0, 0), std::max(col0, 0),
+          std::min(row1, rows_ - 1), std::min(col1, cols_ - 1));
+}
+
+/* Normals, tangents and the finest min/max level are built in a single pass
+ * over the rows, the coarser levels and tiles are reduced from it. */
+void HeightField::build(int row0, int col0, int row1, int col1) {
+    /* central differences reach one texel further, cells one texel back */
+    int texel_row0 = std::max(row0 - 1, 0), texel_row1 = std::min(row1 + 1, rows_ - 1);
+    int texel_col0 = std::max(col0 - 1, 0), texel_col1 = std::min(col1 + 1, cols_ - 1);
+    glm::ivec2 cell_lo(std::max(row0 - 1, 0), std::max(col0 - 1, 0));
+    glm::ivec2 cell_hi = glm::min(glm::ivec2(row1, col1), level_dims_[0] - 1);
+
+    const float k = height_scale_ / 257.0f;
+    const int cell_cols = level_dims_[0].y;
+#pragma omp parallel for schedule(static)
+    for (int i = texel_row0; i <= texel_row1; ++i) {
+        int i_minus = std::max(i - 1, 0), i_plus = std::min(i + 1, rows_ - 1);
+        const uint16_t *row = &samples_[i * cols_];
+        const uint16_t *row_minus = &samples_[i_minus * cols_];
+        const uint16_t *row_plus = &samples_[i_plus * cols_];
+        uint32_t *normal = &normals_[i * cols_];
+        uint32_t *tangent = &tangents_[i * cols_];
+        const float dx_scale = k / float(i_plus - i_minus);
+#pragma omp simd
+        for (int j = texel_col0; j <= texel_col1; ++j) {
+            int j_minus = std::max(j - 1, 0), j_plus = std::min(j + 1, cols_ - 1);
+            float dhdx = (float(row_plus[j]) - float(row_minus[j])) * dx_scale;
+            float dhdz = (float(row[j_plus]) - float(row[j_minus])) * k / float(j_plus - j_minus);
+            /* n = (-dh/dx, 1, -dh/dz) and t = (1, dh/dx, 0) are orthogonal */
+            float n_inv = 1.0f / std::sqrt(dhdx * dhdx + 1.0f + dhdz * dhdz);
+            float t_inv = 1.0f / std::sqrt(1.0f + dhdx * dhdx);
+            normal[j] = packSnorm8(-dhdx * n_inv) | packSnorm8(n_inv) << 8 |
+                        packSnorm8(-dhdz * n_inv) << 16;
+            tangent[j] = packSnorm8(t_inv) | packSnorm8(dhdx * t_inv) << 8 |
+                         packSnorm8(1.0f) << 24;
+        }
+
+        if (i < cell_lo.x || i > cell_hi.x)
+            continue;
+        MinMax *cell = &pyramid_[0][i * cell_cols];
+#pragma omp simd
+        for (int j = cell_lo.y; j <= cell_hi.y; ++j) {
+            cell[j].min = std::min(std::min(row[j], row[j + 1]), std::min(row_plus[j], row_plus[j + 1]));
+            cell[j].max = std::max(std::max(row[j], row[j + 1]), std::max(row_plus[j], row_plus[j + 1]));
+        }
+    }
+
+    glm::ivec2 lo = cell_lo, hi = cell_hi;
+    for (int level = 1; level < levels(); ++level) {
+        lo /= 2;
+        hi /= 2;
+        glm::ivec2 dims = level_dims_[level], child_dims = level_dims_[level - 1];
+        const std::vector<MinMax> &children = pyramid_[level - 1];
+#pragma omp parallel for schedule(static)
+        for (int i = lo.x; i <= hi.x; ++i) {
+            for (int j = lo.y; j <= hi.y; ++j) {
+                int child_row1 = std::min(2 * i + 1, child_dims.x - 1);
+                int child_col1 = std::min(2 * j + 1, child_dims.y - 1);
+                MinMax min_max{UINT16_MAX, 0};
+                for (int ci = 2 * i; ci <= child_row1; ++ci) {
+                    for (int cj = 2 * j; cj <= child_col1; ++cj) {
+                        const MinMax &child = children[ci * child_dims.y + cj];
+                        min_max.min = std::min(min_max.min, child.min);
+                        min_max.max = std::max(min_max.max, child.max);
+                    }
+                }
+                pyramid_[level][i * dims.y + j] = min_max;
+            }
+        }
+    }
+
+    buildTiles(cell_lo.x, cell_lo.y, cell_hi.x, cell_hi.y);
+}
+
+void HeightField::buildTiles(int row0, int col0, int row1, int col1) {
+    constexpr int tile_level = 6;
+    static_assert((1 << tile_level) == TILE_SIZE, "TILE_SIZE must match its pyramid level");
+    tile_dims_ = levelDims(tile_level);
+    tiles_.resize(tile_dims_.x * tile_dims_.y);
+    for (int i = row0 / TILE_SIZE; i <= row1 / TILE_SIZE; ++i) {
+        for (int j = col0 / TILE_SIZE; j <= col1 / TILE_SIZE; ++j) {
+            MinMax min_max = minMax(tile_level, i, j);
+            int tile_row1 = std::min((i + 1) * TILE_SIZE, rows_ - 1);
+            int tile_col1 = std::min((j + 1) * TILE_SIZE, cols_ - 1);
+            tiles_[i * tile_dims_.y + j] = Bounds3(
+                glm::vec3(i * TILE_SIZE - rows_ / 2.0f, sampleToHeight(min_max.min), j * TILE_SIZE - cols_ / 2.0f),
+                glm::vec3(tile_row1 - rows_ / 2.0f, sampleToHeight(min_max.max), tile_col1 - cols_ / 2.0f));
+        }
+    }
+}
+
+void HeightField::heightAt(const float *x, const float *z, float *heights, size_t count) const {
+#pragma omp parallel for simd if (count > 16384)
+    for (size_t n = 0; n < count; ++n)
+        heights[n] = heightAt(x[n], z[n]);
+}
+
+void HeightField::slopeAt(const float *x, const float *z, float *heights, float *dhdx, float *dhdz,
+                          size_t count) const {
+    const uint16_t *samples = samples_.data();
+    const int rows = rows_, cols = cols_;
+    const float scale = height_scale_ / 257.0f;
+#pragma omp parallel for simd if (count > 16384)
+    for (size_t n = 0; n < count; ++n) {
+        int i, j;
+        float u, v;
+        worldToCell(x[n], z[n], rows, cols, &i, &j, &u, &v);
+        const uint16_t *s = samples + i * cols + j;
+        float s00 = s[0], s01 = s[1], s10 = s[cols], s11 = s[cols + 1];
+        heights[n] = sampleToHeight((1 - u) * ((1 - v) * s00 + v * s01) + u * ((1 - v) * s10 + v * s11));
+        /* x runs along rows, z along columns, one world unit per texel */
+        bool inside_x = x[n] + rows / 2.0f > 0.0f && x[n] + rows / 2.0f < float(rows - 1);
+        bool inside_z = z[n] + cols / 2.0f > 0.0f && z[n] + cols / 2.0f < float(cols - 1);
+        dhdx[n] = inside_x ? scale * ((1 - v) * (s10 - s00) + v * (s11 - s01)) : 0.0f;
+        dhdz[n] = inside_z ? scale * ((1 - u) * (s01 - s00) + u * (s11 - s10)) : 0.0f;
+    }
+}
+
+void HeightField::normalAt(const float *x, const float *z, glm::vec3 *normals, size_t count) const {
+#pragma omp parallel for simd if (count > 16384)
+    for (size_t n = 0; n < count; ++n)
+        normals[n] = normalAt(x[n], z[n]);
+}
+
+/* Clip [t0, t1] to the slab lo <= origin + t * direction <= hi of one axis. */
+static inline bool clipSlab(float origin, float direction, float lo, float hi, float *t0, float *t1) {
+    if (direction == 0.0f)
+        return origin >= lo && origin <= hi;
+    float ta = (lo - origin) / direction, tb = (hi - origin) / direction;
+    if (ta > tb)
+        std::swap(ta, tb);
+    *t0 = std::max(*t0, ta);
+    *t1 = std::min(*t1, tb);
+    return *t0 <= *t1;
+}
+
+/* First t in [t0, t1] where the ray meets the bilinear patch through the
+ * corner heights h00 (origin), h10 (+row) h01 (+col) and h11. With the ray
+ * relative to the cell corner, ray height minus patch height is a quadratic
+ * in t, solved in double precision. */
+static bool intersectPatch(float h00, float h10, float h01, float h11, const glm::vec3 &o,
+                           const glm::vec3 &d, float t0, float t1, float *t_hit) {
+    double e = double(h10) - h00, g = double(h01) - h00, k = double(h00) - h10 - h01 + h11;
+    double a = -k * d.x * d.z;
+    double b = d.y - e * d.x - g * d.z - k * (double(o.x) * d.z + double(o.z) * d.x);
+    double c = o.y - h00 - e * o.x - g * o.z - k * o.x * o.z;
+
+    double roots[2];
+    int n = 0;
+    if (std::abs(a) < 1e-12) {
+        if (b != 0.0)
+            roots[n++] = -c / b;
+    } else {
+        double discriminant = b * b - 4.0 * a * c;
+        if (discriminant < 0.0)
+            return false;
+        /* numerically stable form, no cancellation between b and the root */
+        double q = -0.5 * (b + std::copysign(std::sqrt(discriminant), b));
+        roots[n++] = q / a;
+        if (q != 0.0)
+            roots[n++] = c / q;
+        if (n == 2 && roots[1] < roots[0])
+            std::swap(roots[0], roots[1]);
+    }
+    /* tolerate rounding at the cell borders, the neighbour cell agrees */
+    double eps = 1e-5 * (1.0 + std::abs(double(t1)));
+    for (int r = 0; r < n; ++r) {
+        if (roots[r] >= t0 - eps && roots[r] <= t1 + eps) {
+            *t_hit = float(std::min(std::max(roots[r], double(t0)), double(t1)));
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Maximum mipmap traversal: a node whose height range the ray segment over
+ * it stays out of is skipped as a whole, otherwise the child containing the
+ * ray is visited next. After leaving a node the walk continues with its
+ * neighbour, one level up for every parent boundary crossed. */
+bool HeightField::intersect(const glm::vec3 &origin, const glm::vec3 &direction, float t_max,
+                            RayHit *hit) const {
+    /* texel space, x along rows and z along columns */
+    const glm::vec3 o(origin.x + rows_ / 2.0f, origin.y, origin.z + cols_ / 2.0f);
+    const glm::vec3 &d = direction;
+    const float inf = std::numeric_limits<float>::infinity();
+    const int top = levels() - 1;
+
+    /* padded, so rays grazing a flat node are not lost to rounding */
+    auto heightRange = [this](const MinMax &min_max) {
+        float lo = sampleToHeight(min_max.min), hi = sampleToHeight(min_max.max);
+        return (lo <= hi ? glm::vec2(lo, hi) : glm::vec2(hi, lo)) + glm::vec2(-1e-3f, 1e-3f);
+    };
+    glm::vec2 root = heightRange(minMax(top, 0, 0));
+    float t = 0.0f, t1 = t_max;
+    if (!clipSlab(o.x, d.x, 0.0f, float(rows_ - 1), &t, &t1) ||
+        !clipSlab(o.z, d.z, 0.0f, float(cols_ - 1), &t, &t1) ||
+        !clipSlab(o.y, d.y, root.x, root.y, &t, &t1))
+        return false;
+
+    const int step_i = d.x >= 0.0f ? 1 : -1, step_j = d.z >= 0.0f ? 1 : -1;
+    int level = top, i = 0, j = 0;
+    for (;;) {
+        int size = 1 << level;
+        float x0 = float(i * size), x1 = float(std::min((i + 1) * size, rows_ - 1));
+        float z0 = float(j * size), z1 = float(std::min((j + 1) * size, cols_ - 1));
+        float exit_x = d.x != 0.0f ? ((d.x > 0.0f ? x1 : x0) - o.x) / d.x : inf;
+        float exit_z = d.z != 0.0f ? ((d.z > 0.0f ? z1 : z0) - o.z) / d.z : inf;
+        float t_exit = std::min(std::min(exit_x, exit_z), t1);
+
+        glm::vec2 range = heightRange(minMax(level, i, j));
+        float y0 = o.y + d.y * t, y1 = o.y + d.y * t_exit;
+        bool overlap = std::min(y0, y1) <= range.y && std::max(y0, y1) >= range.x;
+        if (overlap && level > 0) {
+            --level;
+            size >>= 1;
+            glm::ivec2 dims = level_dims_[level];
+            float x = o.x + d.x * t, z = o.z + d.z * t;
+            float mid_x = float((2 * i + 1) * size), mid_z = float((2 * j + 1) * size);
+            i = std::min(2 * i + int(x > mid_x || (x == mid_x && d.x > 0.0f)), dims.x - 1);
+            j = std::min(2 * j + int(z > mid_z || (z == mid_z && d.z > 0.0f)), dims.y - 1);
+            continue;
+        }
+        if (overlap) {
+            const uint16_t *s = &samples_[i * cols_ + j];
+            float h00 = sampleToHeight(s[0]), h01 = sampleToHeight(s[1]);
+            float h10 = sampleToHeight(s[cols_]), h11 = sampleToHeight(s[cols_ + 1]);
+            glm::vec3 local = o - glm::vec3(float(i), 0.0f, float(j));
+            float t_hit;
+            if (intersectPatch(h00, h10, h01, h11, local, d, t, t_exit, &t_hit)) {
+                float u = local.x + d.x * t_hit, v = local.z + d.z * t_hit;
+                float k = h00 - h10 - h01 + h11;
+                hit->t = t_hit;
+                hit->position = origin + direction * t_hit;
+                hit->normal = glm::normalize(glm::vec3(-(h10 - h00 + k * v), 1.0f, -(h01 - h00 + k * u)));
+                hit->row = i;
+                hit->col = j;
+                return true;
+            }
+        }
+        /* the segment ends inside this node */
+        if (t_exit >= t1)
+            return false;
+
+        int next_i = i + (exit_x <= exit_z ? step_i : 0);
+        int next_j = j + (exit_z <= exit_x ? step_j : 0);
+        while (level < top && ((next_i >> 1) != (i >> 1) || (next_j >> 1) != (j >> 1))) {
+            next_i >>= 1;
+            next_j >>= 1;
+            i >>= 1;
+            j >>= 1;
+            ++level;
+        }
+        i = next_i;
+        j = next_j;
+        glm::ivec2 dims = level_dims_[level];
+        if (i < 0 || j < 0 || i >= dims.x || j >= dims.y)
+            return false;
+        t = std::max(t, t_exit);
+    }
+}
+
+size_t HeightField::intersect(const glm::vec3 *origins, const glm::vec3 *directions, float t_max,
+                              RayHit *hits, size_t count) const {
+    size_t found = 0;
+    /* ray costs vary a lot, hand out small chunks */
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : found) if (count > 256)
+    for (size_t n = 0; n < count; ++n) {
+        if (intersect(origins[n], directions[n], t_max, &hits[n]))
+            ++found;
+        else
+            hits[n].t = std::numeric_limits<float>::infinity();
+    }
+    return found;
+}
+
+bool HeightField::readCache(const std::string &cache, const std::string &heightmap) {
+    std::ifstream input(cache, std::ios::binary);
+    if (!input)
+        return false;
+    CacheHeader header;
+    input.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!input) {
+        LOG(INFO) << "Terrain cache is truncated: " << cache;
+        return false;
+    }
+    CacheHeader expected = sourceHeader(heightmap, header.rows, header.cols,
+                                        height_scale_, height_offset_);
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+        LOG(INFO) << "Terrain cache is stale: " << cache;
+        return false;
+    }
+
+    rows_ = header.rows;
+    cols_ = header.cols;
+    samples_.resize(rows_ * cols_);
+    allocate();
+    input.read(reinterpret_cast<char *>(samples_.data()), samples_.size() * sizeof(uint16_t));
+    input.read(reinterpret_cast<char *>(normals_.data()), normals_.size() * sizeof(uint32_t));
+    input.read(reinterpret_cast<char *>(tangents_.data()), tangents_.size() * sizeof(uint32_t));
+    for (auto &level : pyramid_)
+        input.read(reinterpret_cast<char *>(level.data()), level.size() * sizeof(MinMax));
+    return bool(input);
+}
+
+void HeightField::writeCache(const std::string &cache, const std::string &heightmap) const {
+    std::ofstream output(cache, std::ios::binary);
+    if (!output) {
+        LOG(WARNING) << "Failed to write terrain cache: " << cache;
+        return;
+    }
+    CacheHeader header = sourceHeader(heightmap, rows_, cols_, height_scale_, height_offset_);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char *>(samples_.data()), samples_.size() * sizeof(uint16_t));
+    output.write(reinterpret_cast<const char *>(normals_.data()), normals_.size() * sizeof(uint32_t));
+    output.write(reinterpret_cast<const char *>(tangents_.data()), tangents_.size() * sizeof(uint32_t));
+    for (const auto &level : pyramid_)
+        output.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(MinMax));
+}
@@ -0,0 +1,125 @@
+#include "litewq/terrain/HeightTiles.h"
+#include "litewq/utils/logging.h"
+
+#include "stb/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace litewq;
+using namespace std::chrono;
+
+namespace {
+
+constexpr char TILES_MAGIC[4] = {'L', 'W', 'Q', 'P'};
+constexpr uint32_t TILES_VERSION = 1;
+constexpr uint64_t PAGE_SIZE = 4096;
+
+} // end anonymous namespace
+
+static inline uint64_t alignPage(uint64_t offset) {
+    return (offset + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
+
+bool HeightTiles::write(const std::string &heightmap, const std::string &output, int tile_size) {
+    CHECK(tile_size > 0) << "Invalid tile size: " << tile_size;
+    high_resolution_clock::time_point t0 = high_resolution_clock::now();
+
+    int rows, cols, channels;
+    stbi_set_flip_vertically_on_load(false);
+    /* 8-bit sources are widened to 16 bits (pixel * 257) */
+    uint16_t *samples = stbi_load_16(heightmap.c_str(), &cols, &rows, &channels, 1);
+    if (!samples) {
+        LOG(WARNING) << "Failed to load heightmap: " << heightmap;
+        return false;
+    }
+
+    const int tile_samples = tile_size + 1;
+    const size_t tile_bytes = size_t(tile_samples) * tile_samples * sizeof(uint16_t);
+    Header header;
+    std::memcpy(header.magic, TILES_MAGIC, sizeof(TILES_MAGIC));
+    header.version = TILES_VERSION;
+    header.rows = rows;
+    header.cols = cols;
+    header.tile_size = tile_size;
+    /* cells are between samples, there is one cell less than samples */
+    header.tile_rows = (rows - 2) / tile_size + 1;
+    header.tile_cols = (cols - 2) / tile_size + 1;
+    header.tile_stride = uint32_t(alignPage(tile_bytes));
+    const size_t tile_count = size_t(header.tile_rows) * header.tile_cols;
+    header.data_offset = alignPage(sizeof(Header) + tile_count * sizeof(MinMax));
+
+    std::ofstream out(output, std::ios::binary);
+    if (!out) {
+        LOG(WARNING) << "Failed to write " << output;
+        stbi_image_free(samples);
+        return false;
+    }
+
+    /* a row of tiles at a time, the min/max table is patched in at the end */
+    std::vector<MinMax> min_max(tile_count);
+    std::vector<char> tile_row(size_t(header.tile_cols) * header.tile_stride, 0);
+    out.seekp(std::streamoff(header.data_offset));
+    for (int tr = 0; tr < header.tile_rows; ++tr) {
+#pragma omp parallel for schedule(static)
+        for (int tc = 0; tc < header.tile_cols; ++tc) {
+            auto *tile = reinterpret_cast<uint16_t *>(&tile_row[size_t(tc) * header.tile_stride]);
+            MinMax range = {UINT16_MAX, 0};
+            for (int i = 0; i < tile_samples; ++i) {
+                const uint16_t *src = &samples[size_t(std::min(tr * tile_size + i, rows - 1)) * cols];
+                for (int j = 0; j < tile_samples; ++j) {
+                    uint16_t s = src[std::min(tc * tile_size + j, cols - 1)];
+                    tile[i * tile_samples + j] = s;
+                    range.min = std::min(range.min, s);
+                    range.max = std::max(range.max, s);
+                }
+            }
+            min_max[size_t(tr) * header.tile_cols + tc] = range;
+        }
+        out.write(tile_row.data(), std::streamsize(tile_row.size()));
+    }
+    stbi_image_free(samples);
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(min_max.data()), std::streamsize(tile_count * sizeof(MinMax)));
+    if (!out) {
+        LOG(WARNING) << "Failed to write " << output;
+        return false;
+    }
+
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    LOG(INFO) << "Tiling " << heightmap << " into " << header.tile_rows << "x" << header.tile_cols
+              << " tiles finished: " << duration<double>(t1 - t0).count() << " s";
+    return true;
+}
+
+bool HeightTiles::open(const std::string &path) {
+    header_ = nullptr;
+    min_max_ = nullptr;
+    if (!file_.open(path))
+        return false;
+    if (file_.size() < sizeof(Header)) {
+        LOG(WARNING) << "Truncated tile file: " << path;
+        file_.close();
+        return false;
+    }
+
+    auto *header = reinterpret_cast<const Header *>(file_.data());
+    uint64_t tile_count = uint64_t(header->tile_rows) * header->tile_cols;
+    uint64_t tile_bytes = uint64_t(header->tile_size + 1) * (header->tile_size + 1) * sizeof(uint16_t);
+    if (std::memcmp(header->magic, TILES_MAGIC, sizeof(TILES_MAGIC)) != 0 ||
+        header->version != TILES_VERSION || header->tile_size <= 0 ||
+        header->tile_stride < tile_bytes ||
+        file_.size() < header->data_offset + tile_count * header->tile_stride) {
+        LOG(WARNING) << "Invalid tile file: " << path;
+        file_.close();
+        return false;
+    }
+    header_ = header;
+    min_max_ = reinterpret_cast<const MinMax *>(file_.data() + sizeof(Header));
+    return true;
+}
@@ -0,0 +1,259 @@
+#include "litewq/terrain/Terrain.h"
+#include "litewq/terrain/TerrainPager.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLErrorHandle.h"
+#include "litewq/utils/logging.h"
+
+#include "glad/glad.h"
+#include "stb/stb_image.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace litewq;
+
+/* Upload a block of samples to the bound height texture, allocating it first
+   when allocate is set. ES 3.0 has no 16 bit normalized formats, there the
+   samples go up normalized as floats, which the shaders read the same way. */
+static void uploadHeights(bool allocate, int row, int col, int rows, int cols, const uint16_t *samples) {
+#ifdef LITEWQ_GLES
+    std::vector<float> texels(size_t(rows) * cols);
+    for (size_t i = 0; i < texels.size(); ++i)
+        texels[i] = samples[i] / 65535.0f;
+    if (allocate) {
+        GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, cols, rows, 0, GL_RED, GL_FLOAT, texels.data()));
+    } else {
+        GL_CHECK(glTexSubImage2D(GL_TEXTURE_2D, 0, col, row, cols, rows, GL_RED, GL_FLOAT, texels.data()));
+    }
+#else
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    if (allocate) {
+        GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, cols, rows, 0, GL_RED, GL_UNSIGNED_SHORT, samples));
+    } else {
+        GL_CHECK(glTexSubImage2D(GL_TEXTURE_2D, 0, col, row, cols, rows, GL_RED, GL_UNSIGNED_SHORT, samples));
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+#endif
+}
+
+Terrain::Terrain(const std::string &heightmap, float height_scale, float height_offset)
+    : height_field_(std::make_unique<HeightField>(heightmap, height_scale, height_offset)),
+      rows_(height_field_->rows_), cols_(height_field_->cols_),
+      height_scale_(height_scale), height_offset_(height_offset)
+{
+    static_assert((1 << LEAF_LEVEL) == GRID_DIM, "A leaf node covers GRID_DIM cells");
+    for (int lod = 0; lod < LOD_COUNT; ++lod)
+        ranges_[lod] = LOD_DISTANCE * float(1 << lod);
+
+    glm::ivec2 root_dims = levelDims(LEAF_LEVEL + LOD_COUNT - 1);
+    LOG(INFO) << "Load terrain: " << heightmap << " rows: " << rows() << " cols: " << cols()
+              << " root nodes: " << root_dims.x * root_dims.y;
+}
+
+Terrain::Terrain(TerrainPager *pager)
+    : pager_(pager), rows_(pager->tiles().header().rows), cols_(pager->tiles().header().cols),
+      height_scale_(pager->heightScale()), height_offset_(pager->heightOffset())
+{
+    for (int lod = 0; lod < LOD_COUNT; ++lod)
+        ranges_[lod] = LOD_DISTANCE * float(1 << lod);
+
+    glm::ivec2 root_dims = levelDims(LEAF_LEVEL + LOD_COUNT - 1);
+    LOG(INFO) << "Page terrain: rows: " << rows() << " cols: " << cols()
+              << " root nodes: " << root_dims.x * root_dims.y;
+}
+
+float Terrain::pagedHeightAt(float x, float z) const {
+    return pager_->heightAt(x, z);
+}
+
+glm::vec3 Terrain::pagedNormalAt(float x, float z) const {
+    /* central differences over one texel, as the vertex shader */
+    float dx = pager_->heightAt(x - 1.0f, z) - pager_->heightAt(x + 1.0f, z);
+    float dz = pager_->heightAt(x, z - 1.0f) - pager_->heightAt(x, z + 1.0f);
+    return glm::normalize(glm::vec3(dx, 2.0f, dz));
+}
+
+void Terrain::updateHeights(int row, int col, int rows, int cols, const uint16_t *samples) {
+    CHECK(height_field_) << "Paged terrain heights are read only";
+    height_field_->updateSamples(row, col, rows, cols, samples);
+
+    glBindTexture(GL_TEXTURE_2D, height_tex_);
+    uploadHeights(false, row, col, rows, cols, samples);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Terrain::initGL() {
+    /* one shared patch, vertices are integer grid coordinates */
+    std::vector<glm::vec2> grid;
+    grid.reserve((GRID_DIM + 1) * (GRID_DIM + 1));
+    for (int i = 0; i <= GRID_DIM; ++i)
+        for (int j = 0; j <= GRID_DIM; ++j)
+            grid.emplace_back(i, j);
+
+    /* indices are grouped by quadrant, so that one quadrant of a node can be
+     * drawn alone when its child takes over the rest. */
+    constexpr int half = GRID_DIM / 2;
+    std::vector<uint16_t> indices;
+    indices.reserve(GRID_DIM * GRID_DIM * 6);
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        int row0 = (quadrant >> 1) * half, col0 = (quadrant & 1) * half;
+        for (int i = row0; i < row0 + half; ++i) {
+            for (int j = col0; j < col0 + half; ++j) {
+                uint16_t index = i * (GRID_DIM + 1) + j;
+                indices.push_back(index);
+                indices.push_back(index + 1);
+                indices.push_back(index + GRID_DIM + 1);
+
+                indices.push_back(index + 1);
+                indices.push_back(index + GRID_DIM + 2);
+                indices.push_back(index + GRID_DIM + 1);
+            }
+        }
+    }
+    quadrant_indices_ = half * half * 6;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, grid.size() * sizeof(glm::vec2), grid.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
+    glBindVertexArray(0);
+
+    /* heights are fetched in the vertex shader, from the pages of a paged terrain */
+    if (pager_)
+        return;
+    glGenTextures(1, &height_tex_);
+    glBindTexture(GL_TEXTURE_2D, height_tex_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+#ifdef LITEWQ_GLES
+    /* float textures are not filterable, the patches fetch at texel centers anyway */
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+#else
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+#endif
+    uploadHeights(true, 0, 0, rows(), cols(), height_field_->samples());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Terrain::finishGL() {
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteTextures(1, &height_tex_);
+}
+
+glm::ivec2 Terrain::levelDims(int level) const {
+    if (height_field_)
+        return height_field_->levelDims(level);
+    /* the same halving as the HeightField pyramid */
+    glm::ivec2 dims(rows() - 1, cols() - 1);
+    for (int l = 0; l < level && dims != glm::ivec2(1, 1); ++l)
+        dims = (dims + 1) / 2;
+    return dims;
+}
+
+Bounds3 Terrain::nodeBound(int lod, int row, int col) const {
+    int size = nodeSize(lod);
+    int row0 = row * size, row1 = std::min(row0 + size, rows() - 1);
+    int col0 = col * size, col1 = std::min(col0 + size, cols() - 1);
+    HeightField::MinMax min_max;
+    if (pager_) {
+        /* the ranges of the tiles holding the node's cells, tiles include their border samples */
+        const HeightTiles &tiles = pager_->tiles();
+        const int tile_size = tiles.header().tile_size;
+        min_max = {std::numeric_limits<uint16_t>::max(), 0};
+        for (int tr = row0 / tile_size; tr <= (row1 - 1) / tile_size; ++tr) {
+            for (int tc = col0 / tile_size; tc <= (col1 - 1) / tile_size; ++tc) {
+                HeightTiles::MinMax tile = tiles.minMax(tr, tc);
+                min_max.min = std::min(min_max.min, tile.min);
+                min_max.max = std::max(min_max.max, tile.max);
+            }
+        }
+    } else {
+        min_max = height_field_->minMax(LEAF_LEVEL + lod, row, col);
+    }
+    return Bounds3(glm::vec3(row0 - rows() / 2.0f, sampleToHeight(min_max.min), col0 - cols() / 2.0f),
+                   glm::vec3(row1 - rows() / 2.0f, sampleToHeight(min_max.max), col1 - cols() / 2.0f));
+}
+
+/* Returns false if the node is out of its LOD range and should be covered
+ * by its parent instead. */
+bool Terrain::selectNode(int lod, int row, int col, bool root) {
+    Bounds3 bound = nodeBound(lod, row, col);
+    if (!root && !IntersectSphere(bound, lod_origin_, ranges_[lod]))
+        return false;
+    /* tiles past the pager's radius are not resident */
+    if (!frustum_.intersect(bound) || (pager_ && !IntersectSphere(bound, lod_origin_, pager_->radius())))
+        return true;
+    if (lod == 0 || !IntersectSphere(bound, lod_origin_, ranges_[lod - 1])) {
+        selection_.push_back({lod, row, col, 4});
+        return true;
+    }
+    glm::ivec2 child_dims = levelDims(LEAF_LEVEL + lod - 1);
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        int child_row = row * 2 + (quadrant >> 1);
+        int child_col = col * 2 + (quadrant & 1);
+        if (child_row >= child_dims.x || child_col >= child_dims.y)
+            continue;
+        if (!selectNode(lod - 1, child_row, child_col, false))
+            selection_.push_back({lod, row, col, quadrant});
+    }
+    return true;
+}
+
+void Terrain::select(const glm::vec3 &lod_origin, const Frustum &frustum) {
+    lod_origin_ = lod_origin;
+    frustum_ = frustum;
+    selection_.clear();
+    glm::ivec2 root_dims = levelDims(LEAF_LEVEL + LOD_COUNT - 1);
+    for (int i = 0; i < root_dims.x; ++i)
+        for (int j = 0; j < root_dims.y; ++j)
+            selectNode(LOD_COUNT - 1, i, j, true);
+}
+
+void Terrain::render(GLShader *shader) const {
+    /* samplers of different types must not share a unit, unused ones included */
+    shader->updateUniformInt("heightMap", height_tex_unit_);
+    shader->updateUniformInt("heightPages", height_tex_unit_ + 1);
+    shader->updateUniformInt("pageTable", height_tex_unit_ + 2);
+    shader->updateUniformInt("paged", pager_ != nullptr);
+    if (pager_) {
+        pager_->bind(shader, height_tex_unit_ + 1);
+    } else {
+        GL_CHECK(glActiveTexture(GL_TEXTURE0 + height_tex_unit_));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, height_tex_));
+    }
+    shader->updateUniformFloat2("heightMapSize", glm::vec2(cols(), rows()));
+    shader->updateUniformFloat2("heightRange", glm::vec2(255.0f * height_scale_, height_offset_));
+    shader->updateUniformFloat3("lodOrigin", lod_origin_);
+    shader->updateUniformFloat("gridDim", GRID_DIM);
+
+    glBindVertexArray(VAO);
+    for (const auto &node : selection_) {
+        int size = nodeSize(node.lod);
+        /* morph into the next coarser grid over the tail of the LOD range,
+         * the coarsest LOD has nothing to morph into. */
+        glm::vec2 morph(std::numeric_limits<float>::max() / 2, std::numeric_limits<float>::max());
+        if (node.lod + 1 < LOD_COUNT) {
+            float prev = node.lod > 0 ? ranges_[node.lod - 1] : 0.0f;
+            morph = glm::vec2(prev + (ranges_[node.lod] - prev) * MORPH_START, ranges_[node.lod]);
+        }
+        shader->updateUniformFloat3("node", glm::vec3(node.row * size, node.col * size, size));
+        shader->updateUniformFloat2("morphRange", morph);
+        if (node.part == 4)
+            glDrawElements(GL_TRIANGLES, 4 * quadrant_indices_, GL_UNSIGNED_SHORT, (void *)0);
+        else
+            glDrawElements(GL_TRIANGLES, quadrant_indices_, GL_UNSIGNED_SHORT,
+                           (void *)(node.part * quadrant_indices_ * sizeof(uint16_t)));
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,298 @@
+#include "litewq/terrain/TerrainPager.h"
+#include "litewq/platform/OpenGL/GLShader.h"
+#include "litewq/platform/OpenGL/GLErrorHandle.h"
+#include "litewq/utils/logging.h"
+
+#include "glad/glad.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+using namespace litewq;
+using namespace std::chrono;
+
+namespace {
+
+/* texture array layers every GL 3.3 implementation supports */
+constexpr size_t MAX_SLOTS = 256;
+
+} // end anonymous namespace
+
+TerrainPager::TerrainPager(const std::string &tiles, float height_scale, float height_offset,
+                           size_t budget_bytes, float radius)
+    : tiles_(tiles), height_scale_(height_scale), height_offset_(height_offset), radius_(radius)
+{
+    CHECK(tiles_.isOpen()) << "Failed to open height tiles: " << tiles;
+    const HeightTiles::Header &header = tiles_.header();
+    size_t slots = std::clamp<size_t>(budget_bytes / tiles_.tileBytes(), 1, MAX_SLOTS);
+    slots_.resize(slots);
+    for (Slot &slot : slots_)
+        slot.samples.resize(tiles_.tileBytes() / sizeof(uint16_t));
+    page_table_.assign(size_t(header.tile_rows) * header.tile_cols, -1);
+    LOG(INFO) << "Terrain pager: " << header.tile_rows << "x" << header.tile_cols << " tiles of "
+              << header.tile_size << " cells, " << slots << " resident";
+
+    worker_ = std::thread(&TerrainPager::work, this);
+}
+
+TerrainPager::~TerrainPager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    worker_.join();
+}
+
+void TerrainPager::initGL() {
+    const int samples = tiles_.tileSamples();
+    glGenTextures(1, &pages_tex_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pages_tex_);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GL_CHECK(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16, samples, samples, slots(), 0,
+                          GL_RED, GL_UNSIGNED_SHORT, nullptr));
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    /* integer texture, read with texelFetch */
+    glGenTextures(1, &page_table_tex_);
+    glBindTexture(GL_TEXTURE_2D, page_table_tex_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_R16I, tiles_.header().tile_cols, tiles_.header().tile_rows,
+                          0, GL_RED_INTEGER, GL_SHORT, page_table_.data()));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    page_table_dirty_ = false;
+}
+
+void TerrainPager::finishGL() {
+    glDeleteTextures(1, &pages_tex_);
+    glDeleteTextures(1, &page_table_tex_);
+    pages_tex_ = page_table_tex_ = 0;
+}
+
+/* A free slot, else the least recently wanted one that is not being read.
+ * keep_wanted spares the tiles wanted in the current frame. */
+int TerrainPager::findSlot(bool keep_wanted) {
+    int best = -1;
+    for (int s = 0; s < slots(); ++s) {
+        const Slot &slot = slots_[s];
+        if (slot.state == SlotState::FREE)
+            return s;
+        if (slot.state == SlotState::LOADING || (keep_wanted && slot.last_used == frame_))
+            continue;
+        if (best < 0 || slot.last_used < slots_[best].last_used)
+            best = s;
+    }
+    return best;
+}
+
+void TerrainPager::evict(int s) {
+    Slot &slot = slots_[s];
+    if (slot.state == SlotState::FREE)
+        return;
+    if (slot.state == SlotState::LOADED || slot.state == SlotState::RESIDENT)
+        ++stats_.evictions;
+    if (page_table_[slot.tile] == s) {
+        page_table_[slot.tile] = -1;
+        page_table_dirty_ = true;
+    }
+    tile_slot_.erase(slot.tile);
+    slot.state = SlotState::FREE;
+    slot.tile = -1;
+}
+
+void TerrainPager::request(int tile, bool urgent) {
+    int s = findSlot(!urgent);
+    if (s < 0) {
+        ++stats_.rejected;
+        return;
+    }
+    evict(s);
+    Slot &slot = slots_[s];
+    slot.state = SlotState::QUEUED;
+    slot.tile = tile;
+    slot.last_used = frame_;
+    tile_slot_[tile] = s;
+    /* stale entries of reused slots are skipped by the worker */
+    if (urgent)
+        queue_.push_front(s);
+    else
+        queue_.push_back(s);
+}
+
+void TerrainPager::update(const glm::vec3 &center) {
+    const HeightTiles::Header &header = tiles_.header();
+    const float size = float(header.tile_size);
+    /* camera in heightmap texels */
+    const glm::vec2 texel(center.x + header.rows / 2.0f, center.z + header.cols / 2.0f);
+    const int row0 = std::max(int((texel.x - radius_) / size), 0);
+    const int row1 = std::min(int((texel.x + radius_) / size), header.tile_rows - 1);
+    const int col0 = std::max(int((texel.y - radius_) / size), 0);
+    const int col1 = std::min(int((texel.y + radius_) / size), header.tile_cols - 1);
+
+    std::vector<std::pair<float, int>> wanted;
+    for (int tr = row0; tr <= row1; ++tr) {
+        for (int tc = col0; tc <= col1; ++tc) {
+            glm::vec2 lo(tr * size, tc * size);
+            glm::vec2 nearest = glm::clamp(texel, lo, lo + size);
+            float distance = glm::length(nearest - texel);
+            if (distance <= radius_)
+                wanted.emplace_back(distance, tr * header.tile_cols + tc);
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++frame_;
+    /* mark everything already cached first, so misses never evict a wanted tile */
+    size_t misses = 0;
+    for (auto &[distance, tile] : wanted) {
+        ++stats_.requests;
+        auto it = tile_slot_.find(tile);
+        if (it == tile_slot_.end()) {
+            wanted[misses++].second = tile;
+            continue;
+        }
+        Slot &slot = slots_[it->second];
+        slot.last_used = frame_;
+        if (slot.state == SlotState::LOADED || slot.state == SlotState::RESIDENT)
+            ++stats_.hits;
+    }
+    /* drop requests that moved out of range before they were read */
+    for (int s = 0; s < slots(); ++s) {
+        if (slots_[s].state == SlotState::QUEUED && slots_[s].last_used != frame_)
+            evict(s);
+    }
+    for (size_t n = 0; n < misses; ++n)
+        request(wanted[n].second, false);
+    lock.unlock();
+    work_cv_.notify_one();
+}
+
+void TerrainPager::work() {
+    const size_t bytes = tiles_.tileBytes();
+    const int tile_cols = tiles_.header().tile_cols;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        work_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_)
+            return;
+        int s = queue_.front();
+        queue_.pop_front();
+        Slot &slot = slots_[s];
+        if (slot.state != SlotState::QUEUED)
+            continue;
+        slot.state = SlotState::LOADING;
+        int tile = slot.tile;
+
+        /* LOADING slots are never evicted, the copy needs no lock */
+        lock.unlock();
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        std::memcpy(slot.samples.data(), tiles_.tile(tile / tile_cols, tile % tile_cols), bytes);
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        lock.lock();
+
+        slot.state = SlotState::LOADED;
+        ++stats_.loads;
+        stats_.load_time += duration<double>(t1 - t0).count();
+        loaded_cv_.notify_all();
+    }
+}
+
+void TerrainPager::upload(int max_tiles) {
+    const int samples = tiles_.tileSamples();
+    std::lock_guard<std::mutex> lock(mutex_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pages_tex_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    for (int s = 0; s < slots() && max_tiles > 0; ++s) {
+        Slot &slot = slots_[s];
+        if (slot.state != SlotState::LOADED)
+            continue;
+        GL_CHECK(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, s, samples, samples, 1,
+                                 GL_RED, GL_UNSIGNED_SHORT, slot.samples.data()));
+        slot.state = SlotState::RESIDENT;
+        page_table_[slot.tile] = int16_t(s);
+        page_table_dirty_ = true;
+        --max_tiles;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    if (page_table_dirty_) {
+        glBindTexture(GL_TEXTURE_2D, page_table_tex_);
+        GL_CHECK(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tiles_.header().tile_cols, tiles_.header().tile_rows,
+                                 GL_RED_INTEGER, GL_SHORT, page_table_.data()));
+        glBindTexture(GL_TEXTURE_2D, 0);
+        page_table_dirty_ = false;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+const uint16_t *TerrainPager::acquire(int tile_row, int tile_col) {
+    const int tile = tile_row * tiles_.header().tile_cols + tile_col;
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = tile_slot_.find(tile);
+    if (it == tile_slot_.end()) {
+        /* every slot is being read, wait for one to finish */
+        while (findSlot(false) < 0)
+            loaded_cv_.wait(lock);
+        request(tile, true);
+        work_cv_.notify_one();
+        it = tile_slot_.find(tile);
+    }
+    Slot &slot = slots_[it->second];
+    slot.last_used = std::max(slot.last_used, frame_);
+    if (slot.state == SlotState::QUEUED || slot.state == SlotState::LOADING) {
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        loaded_cv_.wait(lock, [&slot] {
+            return slot.state == SlotState::LOADED || slot.state == SlotState::RESIDENT;
+        });
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        ++stats_.stalls;
+        stats_.stall_time += duration<double>(t1 - t0).count();
+    }
+    return slot.samples.data();
+}
+
+float TerrainPager::heightAt(float x, float z) {
+    const HeightTiles::Header &header = tiles_.header();
+    float r = std::min(std::max(x + header.rows / 2.0f, 0.0f), float(header.rows - 1));
+    float c = std::min(std::max(z + header.cols / 2.0f, 0.0f), float(header.cols - 1));
+    int i = std::min(int(r), header.rows - 2);
+    int j = std::min(int(c), header.cols - 2);
+    float u = r - i, v = c - j;
+
+    const int size = header.tile_size, stride = tiles_.tileSamples();
+    int tile_row = i / size, tile_col = j / size;
+    const uint16_t *s = acquire(tile_row, tile_col) + (i - tile_row * size) * stride + (j - tile_col * size);
+    float sample = (1 - u) * ((1 - v) * s[0] + v * s[1]) +
+                   u * ((1 - v) * s[stride] + v * s[stride + 1]);
+    return sampleToHeight(sample);
+}
+
+void TerrainPager::bind(GLShader *shader, unsigned int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pages_tex_);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_2D, page_table_tex_);
+    glActiveTexture(GL_TEXTURE0);
+    shader->updateUniformInt("heightPages", int(unit));
+    shader->updateUniformInt("pageTable", int(unit + 1));
+    shader->updateUniformFloat("pageSize", float(tiles_.header().tile_size));
+}
+
+TerrainPager::Stats TerrainPager::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void TerrainPager::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ = Stats();
+}
@@ -0,0 +1,22 @@
+#include "litewq/terrain/HeightTiles.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace litewq;
+
+/* Offline tool: cuts a heightmap into the tile file streamed by TerrainPager.
+ *
+ *   litewq_tiler <heightmap> [output] [tile_size]
+ *
+ * output defaults to "<heightmap>.tiles", tile_size to 256 cells. */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <heightmap> [output] [tile_size]" << std::endl;
+        return 1;
+    }
+    std::string heightmap = argv[1];
+    std::string output = argc > 2 ? argv[2] : heightmap + ".tiles";
+    int tile_size = argc > 3 ? std::atoi(argv[3]) : 256;
+    return HeightTiles::write(heightmap, output, tile_size) ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include "litewq/utils/MappedFile.h"
+#include "litewq/utils/logging.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace litewq;
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG(WARNING) << "Failed to open " << path;
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        LOG(WARNING) << "Failed to map " << path;
+        CloseHandle(file);
+        return false;
+    }
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    size_ = size_t(size.QuadPart);
+    return data_ != nullptr;
+}
+
+void MappedFile::close() {
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_)
+        CloseHandle(file_);
+    data_ = nullptr;
+    mapping_ = file_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(WARNING) << "Failed to open " << path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    /* the mapping stays valid after the descriptor is closed */
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        LOG(WARNING) << "Failed to map " << path;
+        return false;
+    }
+    data_ = static_cast<const unsigned char *>(data);
+    size_ = size_t(st.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_)
+        munmap(const_cast<unsigned char *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif